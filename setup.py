@@ -129,9 +129,12 @@ def platform_config():
     if USE_SYSTEM_LIB:
         if DEBUG:
             config['extra_compile_args'] = ['-g', '-DDEBUG', '-O0']
-            return mozjs_config(config=config)
+            config = mozjs_config(config=config)
         else:
-            return mozjs_config()
+            config = mozjs_config()
+        if sysname == "Linux":
+            config["libraries"].append("dl")
+        return config
     
     # Debug builds are useful for finding errors in
     # the request counting semantics for Spidermonkey
@@ -163,6 +166,10 @@ def platform_config():
             "-DVA_COPY=va_copy"
         ])
 
+    # dladdr() identifies the engine build for serialized scripts.
+    if sysname == "Linux":
+        config["libraries"].append("dl")
+
     # Currently no suppot for Win32, patches welcome.
     if sysname in ["Darwin", "Linux", "FreeBSD"]:
         config["extra_compile_args"].append("-DXP_UNIX")
@@ -0,0 +1,396 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+// Scripts can make up any number of keys, so memos are bounded.
+#define ACCESS_MEMO_MAX 4096
+
+typedef struct {
+    AccessRule* rule;           // NULL when every key is deferred
+    PyObject* verdicts;         // key -> Py_True, Py_False or Py_None
+} AccessMemo;
+
+/*
+    Keys arrive as str from Python and unicode from JavaScript, names
+    in the policy are str.
+*/
+static int
+key_matches(PyObject* key, PyObject* name, int exact)
+{
+    const char* data = PyString_AS_STRING(name);
+    Py_ssize_t len = PyString_GET_SIZE(name);
+    Py_ssize_t i;
+
+    if(PyString_Check(key))
+    {
+        if(exact ? PyString_GET_SIZE(key) != len : PyString_GET_SIZE(key) < len)
+            return 0;
+        return memcmp(PyString_AS_STRING(key), data, len) == 0;
+    }
+
+    if(PyUnicode_Check(key))
+    {
+        Py_UNICODE* chars = PyUnicode_AS_UNICODE(key);
+        if(exact ? PyUnicode_GET_SIZE(key) != len : PyUnicode_GET_SIZE(key) < len)
+            return 0;
+        for(i = 0; i < len; i++)
+        {
+            if(chars[i] != (unsigned char) data[i]) return 0;
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+any_prefix(PyObject* prefixes, PyObject* key)
+{
+    Py_ssize_t i;
+
+    for(i = 0; i < PyTuple_GET_SIZE(prefixes); i++)
+    {
+        if(key_matches(key, PyTuple_GET_ITEM(prefixes, i), 0)) return 1;
+    }
+
+    return 0;
+}
+
+static int
+evaluate(AccessRule* rule, PyObject* key)
+{
+    static PyObject* call_name = NULL;
+    static PyObject* init_name = NULL;
+    int found;
+
+    if(call_name == NULL) call_name = PyString_InternFromString("__call__");
+    if(init_name == NULL) init_name = PyString_InternFromString("__init__");
+    if(call_name == NULL || init_name == NULL) return -1;
+
+    if(rule->call != ACCESS_DEFER && key_matches(key, call_name, 1))
+        return rule->call;
+    if(rule->construct != ACCESS_DEFER && key_matches(key, init_name, 1))
+        return rule->construct;
+
+    if(rule->deny != NULL)
+    {
+        found = PySet_Contains(rule->deny, key);
+        if(found < 0) return -1;
+        if(found) return ACCESS_DENY;
+    }
+    if(any_prefix(rule->deny_prefixes, key)) return ACCESS_DENY;
+
+    if(rule->allow == NULL && PyTuple_GET_SIZE(rule->allow_prefixes) == 0)
+        return ACCESS_DEFER;
+
+    if(rule->allow != NULL)
+    {
+        found = PySet_Contains(rule->allow, key);
+        if(found < 0) return -1;
+        if(found) return ACCESS_ALLOW;
+    }
+    if(any_prefix(rule->allow_prefixes, key)) return ACCESS_ALLOW;
+
+    // Listing what is allowed denies the rest.
+    return ACCESS_DENY;
+}
+
+/*
+    Splits a sequence of names into a frozenset of exact names and a
+    tuple of prefixes, given as "prefix*".
+*/
+static int
+parse_names(PyObject* seq, PyObject** names, PyObject** prefixes)
+{
+    PyObject* item = NULL;
+    Py_ssize_t len;
+    int ret = 0;
+
+    CPyAutoObject exact(PyList_New(0));
+    CPyAutoObject starts(PyList_New(0));
+    if(exact.isNull() || starts.isNull()) return 0;
+
+    if(seq != NULL)
+    {
+        CPyAutoObject iter(PyObject_GetIter(seq));
+        if(iter.isNull()) return 0;
+
+        while((item = PyIter_Next(iter)) != NULL)
+        {
+            if(!PyString_Check(item))
+            {
+                PyErr_SetString(PyExc_TypeError, "Policy names must be strings.");
+                goto done;
+            }
+
+            len = PyString_GET_SIZE(item);
+            if(len > 0 && PyString_AS_STRING(item)[len-1] == '*')
+            {
+                CPyAutoObject prefix(PyString_FromStringAndSize(
+                                        PyString_AS_STRING(item), len-1));
+                if(prefix.isNull()) goto done;
+                if(PyList_Append(starts, prefix) < 0) goto done;
+            }
+            else if(PyList_Append(exact, item) < 0)
+            {
+                goto done;
+            }
+
+            Py_CLEAR(item);
+        }
+        if(PyErr_Occurred()) return 0;
+    }
+
+    *names = NULL;
+    if(seq != NULL)
+    {
+        *names = PyFrozenSet_New(exact);
+        if(*names == NULL) return 0;
+    }
+
+    *prefixes = PyList_AsTuple(starts);
+    if(*prefixes == NULL)
+    {
+        Py_CLEAR(*names);
+        return 0;
+    }
+
+    ret = 1;
+
+done:
+    Py_XDECREF(item);
+    return ret;
+}
+
+static int
+parse_permission(PyObject* spec, const char* name, signed char* verdict)
+{
+    PyObject* val = PyDict_GetItemString(spec, name);
+    int truth;
+
+    *verdict = ACCESS_DEFER;
+    if(val == NULL || val == Py_None) return 1;
+
+    truth = PyObject_IsTrue(val);
+    if(truth < 0) return 0;
+
+    *verdict = truth ? ACCESS_ALLOW : ACCESS_DENY;
+    return 1;
+}
+
+static void
+AccessRule_Free(AccessRule* rule)
+{
+    if(rule == NULL) return;
+    Py_XDECREF(rule->allow);
+    Py_XDECREF(rule->allow_prefixes);
+    Py_XDECREF(rule->deny);
+    Py_XDECREF(rule->deny_prefixes);
+    free(rule);
+}
+
+static AccessRule*
+AccessRule_New(PyObject* spec)
+{
+    AccessRule* rule = NULL;
+
+    if(!PyDict_Check(spec))
+    {
+        PyErr_SetString(PyExc_TypeError, "Access rules must be dicts.");
+        return NULL;
+    }
+
+    rule = (AccessRule*) calloc(1, sizeof(AccessRule));
+    if(rule == NULL) return (AccessRule*) PyErr_NoMemory();
+
+    if(!parse_names(PyDict_GetItemString(spec, "allow"),
+                    &(rule->allow), &(rule->allow_prefixes)))
+        goto error;
+    if(!parse_names(PyDict_GetItemString(spec, "deny"),
+                    &(rule->deny), &(rule->deny_prefixes)))
+        goto error;
+    if(!parse_permission(spec, "call", &(rule->call))) goto error;
+    if(!parse_permission(spec, "construct", &(rule->construct))) goto error;
+
+    return rule;
+
+error:
+    AccessRule_Free(rule);
+    return NULL;
+}
+
+static AccessMemo*
+new_memo(AccessPolicy* policy, PyTypeObject* type)
+{
+    AccessMemo* memo = NULL;
+    AccessRule* rule = NULL;
+    PyObject* mro = type->tp_mro;
+    Py_ssize_t i;
+
+    // A rule for a class covers its subclasses.
+    for(i = 0; mro != NULL && i < PyTuple_GET_SIZE(mro) && rule == NULL; i++)
+    {
+        rule = (AccessRule*) PtrMap_get(&(policy->rules), PyTuple_GET_ITEM(mro, i));
+    }
+    if(rule == NULL) rule = policy->fallback;
+
+    memo = (AccessMemo*) calloc(1, sizeof(AccessMemo));
+    if(memo == NULL) return (AccessMemo*) PyErr_NoMemory();
+
+    memo->rule = rule;
+    memo->verdicts = PyDict_New();
+    if(memo->verdicts == NULL) goto error;
+
+    if(!PtrMap_put(&(policy->memo), type, memo))
+    {
+        PyErr_NoMemory();
+        goto error;
+    }
+    Py_INCREF(type);
+
+    return memo;
+
+error:
+    Py_XDECREF(memo->verdicts);
+    free(memo);
+    return NULL;
+}
+
+static void
+clear_memo(AccessPolicy* policy)
+{
+    PtrMapEntry* entry;
+
+    PtrMap_FOREACH(&(policy->memo), entry)
+    {
+        AccessMemo* memo = (AccessMemo*) entry->value;
+        Py_DECREF(memo->verdicts);
+        free(memo);
+        Py_DECREF((PyObject*) entry->key);
+    }
+    PtrMap_free(&(policy->memo));
+    PtrMap_init(&(policy->memo));
+}
+
+void
+AccessPolicy_clear(AccessPolicy* policy)
+{
+    PtrMapEntry* entry;
+
+    clear_memo(policy);
+
+    PtrMap_FOREACH(&(policy->rules), entry)
+    {
+        AccessRule_Free((AccessRule*) entry->value);
+        Py_DECREF((PyObject*) entry->key);
+    }
+    PtrMap_free(&(policy->rules));
+    PtrMap_init(&(policy->rules));
+
+    AccessRule_Free(policy->fallback);
+    policy->fallback = NULL;
+}
+
+int
+AccessPolicy_set(AccessPolicy* policy, PyObject* spec)
+{
+    AccessPolicy fresh;
+    PyObject* key = NULL;
+    PyObject* val = NULL;
+    AccessRule* rule = NULL;
+    Py_ssize_t pos = 0;
+
+    if(spec != Py_None && !PyDict_Check(spec))
+    {
+        PyErr_SetString(PyExc_TypeError, "Access policy must be a dict or None.");
+        return 0;
+    }
+
+    // Build the new policy aside so a bad spec leaves the old one.
+    PtrMap_init(&(fresh.rules));
+    PtrMap_init(&(fresh.memo));
+    fresh.fallback = NULL;
+
+    while(spec != Py_None && PyDict_Next(spec, &pos, &key, &val))
+    {
+        if(key != Py_None && !PyType_Check(key))
+        {
+            PyErr_SetString(PyExc_TypeError, "Access policy keys must be types or None.");
+            goto error;
+        }
+
+        rule = AccessRule_New(val);
+        if(rule == NULL) goto error;
+
+        if(key == Py_None)
+        {
+            fresh.fallback = rule;
+            continue;
+        }
+
+        if(!PtrMap_put(&(fresh.rules), key, rule))
+        {
+            AccessRule_Free(rule);
+            PyErr_NoMemory();
+            goto error;
+        }
+        Py_INCREF(key);
+    }
+
+    AccessPolicy_clear(policy);
+    *policy = fresh;
+    return 1;
+
+error:
+    AccessPolicy_clear(&fresh);
+    return 0;
+}
+
+int
+AccessPolicy_check(AccessPolicy* policy, PyObject* obj, PyObject* key)
+{
+    PyTypeObject* type = Py_TYPE(obj);
+    AccessMemo* memo = NULL;
+    PyObject* hit = NULL;
+    int verdict;
+
+    if(key == NULL)
+    {
+        PyErr_BadInternalCall();
+        return -1;
+    }
+
+    memo = (AccessMemo*) PtrMap_get(&(policy->memo), type);
+    if(memo == NULL)
+    {
+        memo = new_memo(policy, type);
+        if(memo == NULL) return -1;
+    }
+
+    if(memo->rule == NULL) return ACCESS_DEFER;
+
+    hit = PyDict_GetItem(memo->verdicts, key);
+    if(hit != NULL)
+    {
+        if(hit == Py_True) return ACCESS_ALLOW;
+        if(hit == Py_False) return ACCESS_DENY;
+        return ACCESS_DEFER;
+    }
+
+    verdict = evaluate(memo->rule, key);
+    if(verdict < 0) return -1;
+
+    if(PyDict_Size(memo->verdicts) >= ACCESS_MEMO_MAX)
+        PyDict_Clear(memo->verdicts);
+
+    hit = verdict == ACCESS_ALLOW ? Py_True : (verdict == ACCESS_DENY ? Py_False : Py_None);
+    if(PyDict_SetItem(memo->verdicts, key, hit) < 0) return -1;
+
+    return verdict;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_ACCESS_H
+#define PYSM_ACCESS_H
+
+/*
+    A declarative access policy, checked before the Python access
+    handler. See Context.set_access_policy. Verdicts are memoized per
+    type and key; keys the policy has no opinion on are left to the
+    handler.
+*/
+
+enum {
+    ACCESS_DENY = 0,
+    ACCESS_ALLOW = 1,
+    ACCESS_DEFER = 2
+};
+
+typedef struct {
+    PyObject* allow;            // frozenset of names, NULL allows any
+    PyObject* allow_prefixes;   // tuple of strings, from "name*"
+    PyObject* deny;
+    PyObject* deny_prefixes;
+    signed char call;           // ACCESS_* for "__call__"
+    signed char construct;      // ACCESS_* for "__init__"
+} AccessRule;
+
+typedef struct {
+    PtrMap rules;               // PyTypeObject* -> AccessRule*, holding the type
+    AccessRule* fallback;       // Rule for types without one, from the None key
+    PtrMap memo;                // PyTypeObject* -> AccessMemo*, holding the type
+} AccessPolicy;
+
+#define AccessPolicy_ACTIVE(policy) \
+    ((policy)->fallback != NULL || (policy)->rules.count > 0)
+
+int AccessPolicy_set(AccessPolicy* policy, PyObject* spec);
+void AccessPolicy_clear(AccessPolicy* policy);
+// Returns an ACCESS_* verdict, or -1 with an exception set.
+int AccessPolicy_check(AccessPolicy* policy, PyObject* obj, PyObject* key);
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+static const struct {
+    const char* name;
+    PyTypeObject* type;
+    char conv;
+} conversions[] = {
+    {"any", &PyBaseObject_Type, BIND_ANY},
+    {"int", &PyInt_Type, BIND_INT},
+    {"float", &PyFloat_Type, BIND_FLOAT},
+    {"bool", &PyBool_Type, BIND_BOOL},
+    {"str", &PyString_Type, BIND_STR},
+    {"unicode", &PyUnicode_Type, BIND_STR},
+    {NULL, NULL, 0}
+};
+
+static int
+parse_conversion(PyObject* spec, char* conv)
+{
+    const char* name;
+    int i;
+
+    if(spec == Py_None)
+    {
+        *conv = BIND_ANY;
+        return 1;
+    }
+
+    name = PyString_Check(spec) ? PyString_AS_STRING(spec) : NULL;
+    // Either a name or the type itself: {"x": "int"} or {"x": int}.
+    for(i = 0; conversions[i].name != NULL; i++)
+    {
+        if((PyObject*) conversions[i].type == spec
+                || (name != NULL && strcmp(name, conversions[i].name) == 0))
+        {
+            *conv = conversions[i].conv;
+            return 1;
+        }
+    }
+
+    PyErr_SetString(PyExc_ValueError,
+        "Conversion must be None, 'any', 'int', 'float', 'bool' or 'str'.");
+    return 0;
+}
+
+static PyObject*
+interned_name(PyObject* name)
+{
+    if(!PyString_Check(name))
+    {
+        PyErr_SetString(PyExc_TypeError, "Bound names must be strings.");
+        return NULL;
+    }
+
+    Py_INCREF(name);
+    PyString_InternInPlace(&name);
+    return name;
+}
+
+Binding*
+Binding_New(PyObject* properties, PyObject* methods, PyObject* readonly)
+{
+    Binding* ret = NULL;
+    PyObject* key = NULL;
+    PyObject* val = NULL;
+    PyObject* name = NULL;
+    Py_ssize_t pos = 0;
+    Py_ssize_t i = 0;
+    Py_ssize_t n;
+
+    if(!PyDict_Check(properties))
+    {
+        PyErr_SetString(PyExc_TypeError, "Properties must be a dict.");
+        return NULL;
+    }
+
+    n = PyDict_Size(properties);
+    if(n > BINDING_MAX_PROPERTIES)
+    {
+        PyErr_SetString(PyExc_ValueError, "Too many bound properties.");
+        return NULL;
+    }
+
+    ret = (Binding*) calloc(1, sizeof(Binding));
+    if(ret == NULL) return (Binding*) PyErr_NoMemory();
+
+    ret->names = PyTuple_New(n);
+    ret->convs = (char*) calloc(n + 1, 1);
+    ret->readonly = (char*) calloc(n + 1, 1);
+    if(ret->names == NULL || ret->convs == NULL || ret->readonly == NULL)
+    {
+        if(!PyErr_Occurred()) PyErr_NoMemory();
+        goto error;
+    }
+
+    while(PyDict_Next(properties, &pos, &key, &val))
+    {
+        name = interned_name(key);
+        if(name == NULL) goto error;
+        PyTuple_SET_ITEM(ret->names, i, name);
+
+        if(!parse_conversion(val, &(ret->convs[i]))) goto error;
+
+        if(readonly != NULL)
+        {
+            int found = PySequence_Contains(readonly, key);
+            if(found < 0) goto error;
+            ret->readonly[i] = found;
+        }
+        i++;
+    }
+
+    // A read-only name has to be one of the properties.
+    if(readonly != NULL && readonly != Py_None)
+    {
+        CPyAutoObject names(PySequence_Fast(readonly, "Read-only names must be a sequence."));
+        if(names.isNull()) goto error;
+
+        for(i = 0; i < PySequence_Fast_GET_SIZE((PyObject*) names); i++)
+        {
+            key = PySequence_Fast_GET_ITEM((PyObject*) names, i);
+            int found = PyDict_Contains(properties, key);
+            if(found < 0) goto error;
+            if(!found)
+            {
+                PyErr_Format(PyExc_ValueError,
+                    "Read-only name %s is not a bound property.",
+                    PyString_Check(key) ? PyString_AS_STRING(key) : "?");
+                goto error;
+            }
+        }
+    }
+
+    if(methods == NULL) methods = Py_None;
+    if(methods == Py_None)
+    {
+        ret->methods = PyTuple_New(0);
+    }
+    else
+    {
+        ret->methods = PySequence_Tuple(methods);
+    }
+    if(ret->methods == NULL) goto error;
+
+    for(i = 0; i < PyTuple_GET_SIZE(ret->methods); i++)
+    {
+        name = interned_name(PyTuple_GET_ITEM(ret->methods, i));
+        if(name == NULL) goto error;
+        PyTuple_SET_ITEM(ret->methods, i, name);
+    }
+
+    return ret;
+
+error:
+    Binding_Free(ret);
+    return NULL;
+}
+
+void
+Binding_Free(Binding* binding)
+{
+    Py_XDECREF(binding->names);
+    Py_XDECREF(binding->methods);
+    free(binding->convs);
+    free(binding->readonly);
+    free(binding);
+}
+
+Binding*
+Binding_Find(PtrMap* bindings, PyTypeObject* type)
+{
+    Binding* ret = (Binding*) PtrMap_get(bindings, type);
+    PyObject* mro = type->tp_mro;
+    Py_ssize_t i;
+
+    if(ret != NULL || mro == NULL || bindings->count == 0) return ret;
+
+    for(i = 1; i < PyTuple_GET_SIZE(mro); i++)
+    {
+        ret = (Binding*) PtrMap_get(bindings, PyTuple_GET_ITEM(mro, i));
+        if(ret != NULL) return ret;
+    }
+
+    return NULL;
+}
+
+/*
+    The receiver may be the prototype itself, or some object that
+    inherits from it, rather than one of our wrappers. A script can
+    also give a wrapper another type's prototype, whose tinyids don't
+    index this binding, so the receiver must still have its own.
+*/
+static PyObject*
+bound_target(JSContext* jscx, JSObject* obj, jsid id, Context** pycx, Binding** binding)
+{
+    PyObject* pyobj = NULL;
+    JSObject* proto = NULL;
+    jsval* slot = NULL;
+
+    *pycx = (Context*) JS_GetContextPrivate(jscx);
+    if(*pycx == NULL)
+    {
+        JS_ReportError(jscx, "Failed to get Python context.");
+        return NULL;
+    }
+
+    if(JS_GetClass(obj)->finalize != js_finalize) return NULL;
+
+    pyobj = get_py_obj(obj);
+    if(pyobj == NULL) return NULL;
+
+    *binding = (Binding*) PtrMap_get(&((*pycx)->bound), Py_TYPE(pyobj));
+    if(*binding == NULL) return NULL;
+
+    if(!JSID_IS_INT(id) || JSID_TO_INT(id) < 0
+            || JSID_TO_INT(id) >= PyTuple_GET_SIZE((*binding)->names))
+        return NULL;
+
+    slot = (jsval*) PtrMap_get(&((*pycx)->protos), Py_TYPE(pyobj));
+    if(slot == NULL || !JS_GetPrototype(jscx, obj, &proto)
+            || proto != JSVAL_TO_OBJECT(*slot))
+        return NULL;
+
+    return pyobj;
+}
+
+static JSBool
+js_bound_get(JSContext* jscx, JS::HandleObject obj, JS::HandleId id, JS::MutableHandleValue vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    Binding* binding = NULL;
+    PyObject* pyobj = NULL;
+    PyObject* name = NULL;
+    int tinyid = JSID_TO_INT(id);
+    jsval rval = JSVAL_VOID;
+
+    pyobj = bound_target(jscx, obj, id, &pycx, &binding);
+    if(pyobj == NULL)
+    {
+        if(pycx == NULL) return JS_FALSE;
+        vp.setUndefined();
+        return JS_TRUE;
+    }
+
+    name = PyTuple_GET_ITEM(binding->names, tinyid);
+    if(Context_has_access(pycx, jscx, pyobj, name) <= 0) return JS_FALSE;
+
+    CPyAutoObject val(PyObject_GetAttr(pyobj, name));
+    if(val.isNull())
+    {
+        JS_ReportError(jscx, "Failed to get bound attribute.");
+        return JS_FALSE;
+    }
+
+    switch(binding->convs[tinyid])
+    {
+        case BIND_INT:
+            if(!PyInt_Check(val) && !PyLong_Check(val)) goto badtype;
+            rval = py2js_integer(pycx, val);
+            break;
+        case BIND_FLOAT:
+        {
+            double num;
+            if(!PyFloat_Check(val) && !PyInt_Check(val) && !PyLong_Check(val)) goto badtype;
+            // Longs too large for a double overflow.
+            num = PyFloat_AsDouble(val);
+            if(num == -1.0 && PyErr_Occurred()) goto badtype;
+            rval = JS_NumberValue(num);
+            break;
+        }
+        case BIND_BOOL:
+            if(!PyBool_Check(val)) goto badtype;
+            rval = val == Py_True ? JSVAL_TRUE : JSVAL_FALSE;
+            break;
+        case BIND_STR:
+            if(!PyString_Check(val) && !PyUnicode_Check(val)) goto badtype;
+            rval = py2js_string(pycx, val);
+            break;
+        default:
+            rval = py2js(pycx, val);
+    }
+
+    if(JSVAL_IS_VOID(rval))
+    {
+        JS_ReportError(jscx, "Failed to convert bound attribute.");
+        return JS_FALSE;
+    }
+
+    vp.set(rval);
+    return JS_TRUE;
+
+badtype:
+    JS_ReportError(jscx, "Bound attribute %s has the wrong type.",
+                    PyString_AS_STRING(name));
+    return JS_FALSE;
+}
+
+static JSBool
+js_bound_set(JSContext* jscx, JS::HandleObject obj, JS::HandleId id, JSBool strict,
+                JS::MutableHandleValue vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    Binding* binding = NULL;
+    PyObject* pyobj = NULL;
+    PyObject* name = NULL;
+    int tinyid = JSID_TO_INT(id);
+    jsval val = vp.get();
+    double num;
+
+    pyobj = bound_target(jscx, obj, id, &pycx, &binding);
+    if(pyobj == NULL) return pycx != NULL;
+
+    name = PyTuple_GET_ITEM(binding->names, tinyid);
+    if(binding->readonly[tinyid])
+    {
+        JS_ReportError(jscx, "Bound attribute %s is read-only.",
+                        PyString_AS_STRING(name));
+        return JS_FALSE;
+    }
+
+    if(Context_has_access(pycx, jscx, pyobj, name) <= 0) return JS_FALSE;
+
+    CPyAutoObject pyval(NULL);
+    switch(binding->convs[tinyid])
+    {
+        case BIND_INT:
+            if(!JSVAL_IS_NUMBER(val)) goto badtype;
+            if(JSVAL_IS_INT(val))
+            {
+                pyval = js2py_integer(pycx, val);
+                break;
+            }
+            num = JSVAL_TO_DOUBLE(val);
+            // Casting NaN or an out of range double is undefined.
+            if(!(num >= -9223372036854775808.0 && num < 9223372036854775808.0)) goto badtype;
+            if(num != (double) (long long) num) goto badtype;
+            pyval = PyLong_FromLongLong((long long) num);
+            break;
+        case BIND_FLOAT:
+            if(!JSVAL_IS_NUMBER(val)) goto badtype;
+            num = JSVAL_IS_INT(val) ? JSVAL_TO_INT(val) : JSVAL_TO_DOUBLE(val);
+            pyval = PyFloat_FromDouble(num);
+            break;
+        case BIND_BOOL:
+            if(!JSVAL_IS_BOOLEAN(val)) goto badtype;
+            pyval = Py_INCREF_RET(JSVAL_TO_BOOLEAN(val) ? Py_True : Py_False);
+            break;
+        case BIND_STR:
+            if(!JSVAL_IS_STRING(val)) goto badtype;
+            pyval = js2py_string(pycx, val);
+            break;
+        default:
+            pyval = js2py(pycx, val);
+    }
+    if(pyval.isNull()) return JS_FALSE;
+
+    if(PyObject_SetAttr(pyobj, name, pyval) < 0)
+    {
+        JS_ReportError(jscx, "Failed to set bound attribute.");
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+
+badtype:
+    JS_ReportError(jscx, "Wrong type assigned to bound attribute %s.",
+                    PyString_AS_STRING(name));
+    return JS_FALSE;
+}
+
+int
+Binding_define(Context* cx, JSObject* proto, Binding* binding)
+{
+    Py_ssize_t i;
+    unsigned attrs;
+
+    for(i = 0; i < PyTuple_GET_SIZE(binding->names); i++)
+    {
+        attrs = JSPROP_SHARED | JSPROP_PERMANENT | JSPROP_SHORTID | JSPROP_ENUMERATE;
+        if(!JS_DefinePropertyWithTinyId(cx->cx, proto,
+                PyString_AS_STRING(PyTuple_GET_ITEM(binding->names, i)), (int8_t) i,
+                JSVAL_VOID, js_bound_get, js_bound_set, attrs))
+            return 0;
+    }
+
+    for(i = 0; i < PyTuple_GET_SIZE(binding->methods); i++)
+    {
+        if(JS_DefineFunction(cx->cx, proto,
+                PyString_AS_STRING(PyTuple_GET_ITEM(binding->methods, i)),
+                js_method, 0, 0) == NULL)
+            return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_BINDINGS_H
+#define PYSM_BINDINGS_H
+
+/*
+    A declared shape for a Python type, see Runtime.register_class.
+    Declared attributes become shared accessor properties on the
+    type's prototype, identified by their tinyid, so reading them
+    skips js_get_prop and its key conversion entirely.
+*/
+
+enum {
+    BIND_ANY = 0,
+    BIND_INT,
+    BIND_FLOAT,
+    BIND_BOOL,
+    BIND_STR
+};
+
+// tinyids are signed bytes.
+#define BINDING_MAX_PROPERTIES 127
+
+typedef struct {
+    PyObject* names;        // tuple of interned attribute names, by tinyid
+    char* convs;            // BIND_* per attribute
+    char* readonly;         // per attribute
+    PyObject* methods;      // tuple of method names
+} Binding;
+
+struct Context;
+
+Binding* Binding_New(PyObject* properties, PyObject* methods, PyObject* readonly);
+void Binding_Free(Binding* binding);
+// Finds the binding for type or its nearest registered base.
+Binding* Binding_Find(PtrMap* bindings, PyTypeObject* type);
+int Binding_define(struct Context* cx, JSObject* proto, Binding* binding);
+
+#endif
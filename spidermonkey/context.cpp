@@ -18,7 +18,7 @@ JSBool set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSB
 
 char Context_thread_OK(Context* self)
 {
-    if (self->thread_active)
+    if (self->rt->thread == PyThread_get_thread_ident())
 	return 1;
 
     PyErr_SetString(JSError, "Context not associated with thread.  Operation illegal.");
@@ -49,12 +49,70 @@ PyObject* get_cxglobal(Context* self)
     return ret;
 }
 
+// Scripts can probe any number of names.
+#define MISSES_MAX 4096
+
+void
+Context_forget_misses(Context* self)
+{
+    PtrMapEntry* entry;
+
+    PtrMap_FOREACH(&(self->misses), entry)
+    {
+        Py_DECREF((PyObject*) entry->value);
+    }
+    PtrMap_clear(&(self->misses));
+    self->misses_stale = 0;
+}
+
+/*
+    Only exact dict globals are cached. Other mappings, subclasses
+    included, may compute their keys, so every lookup still goes to
+    them. A hit still probes the dict with the key it was converted to,
+    which runs no Python code, so only the conversion and the access
+    check are skipped and changes made from Python are always seen.
+*/
+static int
+known_missing(Context* pycx, PyObject* global, jsid id)
+{
+    PyObject* key = NULL;
+
+    if(!PyDict_CheckExact(global) || !JSID_IS_STRING(id)) return 0;
+
+    if(pycx->misses_stale) Context_forget_misses(pycx);
+    if(pycx->misses.count == 0) return 0;
+
+    key = (PyObject*) PtrMap_get(&(pycx->misses), (void*) JSID_BITS(id));
+    if(key == NULL) return 0;
+    if(PyDict_GetItem(global, key) == NULL) return 1;
+
+    PtrMap_remove(&(pycx->misses), (void*) JSID_BITS(id));
+    Py_DECREF(key);
+    return 0;
+}
+
+static void
+remember_missing(Context* pycx, PyObject* global, jsid id, PyObject* key)
+{
+    if(!PyDict_CheckExact(global) || !JSID_IS_STRING(id)) return;
+
+    if(pycx->misses_stale || pycx->misses.count >= MISSES_MAX)
+        Context_forget_misses(pycx);
+
+    // Out of memory only means the miss isn't cached.
+    if(PtrMap_put(&(pycx->misses), (void*) JSID_BITS(id), key)) Py_INCREF(key);
+}
+
 JSBool add_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JS::MutableHandleValue rval)
 {
     JSObject* obj;
+    Context* pycx = (Context*) JS_GetContextPrivate(jscx);
 
     if (rval.isNull() || rval.isPrimitive()) return JS_TRUE;
 
+    // The value came from the Python global in the first place.
+    if (pycx != NULL && pycx->materializing) return JS_TRUE;
+
     obj = &rval.toObject();
     if(!JS_ObjectIsFunction(jscx, obj))
 	return JS_TRUE;
@@ -64,6 +122,7 @@ JSBool add_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JS:
 
 JSBool del_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSBool *succeeded)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pykey = NULL;
     PyObject* pyval = NULL;
@@ -82,13 +141,17 @@ JSBool del_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSB
         goto done;
     }
 
-    // Bail if there's no available global handler.
-    if ((global = get_cxglobal(pycx)) == NULL)
+    // Nothing on the Python side can veto the delete.
+    if (pycx->invalidating || (global = get_cxglobal(pycx)) == NULL)
     {
+        *succeeded = TRUE;
         ret = JS_TRUE;
         goto done;
     }
     
+    pykey = PyDict_CheckExact(global) ? js2py_key(pycx, keyid) : js2py(pycx, key);
+    if(pykey == NULL) goto done;
+
     // Check access to python land.
     if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
 
@@ -100,11 +163,11 @@ JSBool del_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSB
         goto done;
     }
 
-    pykey = js2py(pycx, key);
-    if(pykey == NULL) goto done;
-
     if(PyObject_DelItem(global, pykey) < 0) goto done;
 
+    if(pycx->materialized != NULL && PySet_Discard(pycx->materialized, pykey) < 0)
+        goto done;
+
     *succeeded = TRUE;
     ret = JS_TRUE;
 
@@ -117,6 +180,7 @@ done:
 
 JSBool get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JS::MutableHandleValue rval)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pykey = NULL;
     PyObject* pyval = NULL;
@@ -140,20 +204,39 @@ JSBool get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JS:
         goto done;
     }
 
-    pykey = js2py(pycx, key);
-    if(pykey == NULL) goto done;
+    if(PyDict_CheckExact(global))
+    {
+        pykey = js2py_key(pycx, keyid);
+        if(pykey == NULL) goto done;
 
-    if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
+        if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
 
-    pyval = PyObject_GetItem(global, pykey);
-    if(pyval == NULL)
-    {
-        if(PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_KeyError))
+        // Borrowed, and a missing key raises nothing.
+        pyval = PyDict_GetItem(global, pykey);
+        if(pyval == NULL)
         {
-            PyErr_Clear();
             ret = JS_TRUE;
+            goto done;
+        }
+        Py_INCREF(pyval);
+    }
+    else
+    {
+        pykey = js2py(pycx, key);
+        if(pykey == NULL) goto done;
+
+        if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
+
+        pyval = PyObject_GetItem(global, pykey);
+        if(pyval == NULL)
+        {
+            if(PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_KeyError))
+            {
+                PyErr_Clear();
+                ret = JS_TRUE;
+            }
+            goto done;
         }
-        goto done;
     }
 
     rval.set(py2js(pycx, pyval));
@@ -170,6 +253,7 @@ done:
 
 JSBool set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSBool strict, JS::MutableHandleValue rval)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pykey = NULL;
     PyObject* pyval = NULL;
@@ -201,7 +285,18 @@ JSBool set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSB
     pyval = js2py(pycx, rval);
     if(pyval == NULL) goto done;
 
-    if(PyObject_SetItem(global, pykey, pyval) < 0) goto done;
+    if(PyDict_CheckExact(global))
+    {
+        if(PyDict_SetItem(global, pykey, pyval) < 0) goto done;
+    }
+    else if(PyObject_SetItem(global, pykey, pyval) < 0)
+    {
+        goto done;
+    }
+
+    // Globals created by scripts are copies too once written back.
+    if(pycx->materialized != NULL && PySet_Add(pycx->materialized, pykey) < 0)
+        goto done;
 
     ret = JS_TRUE;
 
@@ -214,11 +309,13 @@ done:
 
 JSBool resolve(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pykey = NULL;
     PyObject* global = NULL;
     jsid pid;
     JSBool ret = JS_FALSE;
+    int found;
     jsval key;
 
     JS_IdToValue(jscx, keyid, &key);
@@ -237,13 +334,25 @@ JSBool resolve(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid)
         goto done;
     }
 
-    pykey = js2py(pycx, key);
+    if(known_missing(pycx, global, keyid))
+    {
+        ret = JS_TRUE;
+        goto done;
+    }
+
+    pykey = PyDict_CheckExact(global) ? js2py_key(pycx, keyid) : js2py(pycx, key);
     if(pykey == NULL) goto done;
     
     if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
 
-    if(!PyMapping_HasKey(global, pykey))
+    if(PyDict_CheckExact(global))
+        found = PyDict_GetItem(global, pykey) != NULL;
+    else
+        found = PyMapping_HasKey(global, pykey);
+
+    if(!found)
     {
+        remember_missing(pycx, global, keyid, pykey);
         ret = JS_TRUE;
         goto done;
     }
@@ -269,6 +378,101 @@ done:
     return ret;
 }
 
+/*
+    The resolve hook of materialized globals. It copies the value into
+    an ordinary data property instead of defining a shared one, so
+    reads never come back to Python and the JITs can cache them. The
+    class setter still writes through. Context.invalidate() deletes the
+    copies so they are resolved again.
+*/
+JSBool resolve_materialized(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyObject* pykey = NULL;
+    PyObject* pyval = NULL;
+    PyObject* global = NULL;
+    JSBool ret = JS_FALSE;
+    JSBool defined;
+    jsval key;
+    jsval val;
+
+    JS_IdToValue(jscx, keyid, &key);
+
+    pycx = (Context*) JS_GetContextPrivate(jscx);
+    if(pycx == NULL)
+    {
+        JS_ReportError(jscx, "Failed to get Python context.");
+        goto done;
+    }
+
+    if ((global = get_cxglobal(pycx)) == NULL)
+    {
+        ret = JS_TRUE;
+        goto done;
+    }
+
+    if(known_missing(pycx, global, keyid))
+    {
+        ret = JS_TRUE;
+        goto done;
+    }
+
+    pykey = PyDict_CheckExact(global) ? js2py_key(pycx, keyid) : js2py(pycx, key);
+    if(pykey == NULL) goto done;
+
+    if(Context_has_access(pycx, jscx, global, pykey) <= 0) goto done;
+
+    if(PyDict_CheckExact(global))
+    {
+        pyval = PyDict_GetItem(global, pykey);
+        Py_XINCREF(pyval);
+        if(pyval == NULL)
+        {
+            remember_missing(pycx, global, keyid, pykey);
+            ret = JS_TRUE;
+            goto done;
+        }
+    }
+    else
+    {
+        pyval = PyObject_GetItem(global, pykey);
+        if(pyval == NULL)
+        {
+            if(PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_KeyError))
+            {
+                PyErr_Clear();
+                remember_missing(pycx, global, keyid, pykey);
+                ret = JS_TRUE;
+            }
+            goto done;
+        }
+    }
+
+    val = py2js(pycx, pyval);
+    if(JSVAL_IS_VOID(val)) goto done;
+
+    pycx->materializing = 1;
+    defined = JS_DefinePropertyById(jscx, pycx->root, keyid, val, NULL, NULL,
+                            JSPROP_ENUMERATE);
+    pycx->materializing = 0;
+    if(!defined)
+    {
+        JS_ReportError(jscx, "Failed to define property.");
+        goto done;
+    }
+
+    if(PySet_Add(pycx->materialized, pykey) < 0) goto done;
+
+    ret = JS_TRUE;
+
+done:
+    Py_XDECREF(global);
+    Py_XDECREF(pykey);
+    Py_XDECREF(pyval);
+    return ret;
+}
+
 static JSClass
 js_global_class = {
     "JSGlobalObjectClass",
@@ -284,33 +488,57 @@ js_global_class = {
     JSCLASS_NO_OPTIONAL_MEMBERS
 };
 
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
+static JSClass
+js_materialized_global_class = {
+    "JSGlobalObjectClass",
+    JSCLASS_GLOBAL_FLAGS,
+    add_prop,
+    del_prop,
+    JS_PropertyStub,
+    set_prop,
+    JS_EnumerateStub,
+    resolve_materialized,
+    JS_ConvertStub,
+    NULL,
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+/*
+    Only invoked when someone triggered the operation callback, so
+    there is no cost as long as no deadline or interrupt is pending.
+*/
 JSBool
 branch_cb(JSContext* jscx)
 {
     Context* pycx = (Context*) JS_GetContextPrivate(jscx);
-    time_t now = time(NULL);
 
     if(pycx == NULL)
     {
+        CPyAutoGIL gil;
         JS_ReportError(jscx, "Failed to find Python context.");
         return JS_FALSE;
     }
 
-    // Get out quick if we don't have any quotas.
-    if(pycx->max_time == 0 && pycx->max_heap == 0)
+    // Get out quick if we don't have anything to enforce.
+    if(!pycx->interrupted && !pycx->timed_out && pycx->max_heap == 0)
     {
         return JS_TRUE;
     }
 
-    // Only check occasionally for resource usage.
-    pycx->branch_count++;
-    if((pycx->branch_count > 0x3FFF) != 1)
+    CPyAutoGIL gil;
+
+    if(pycx->interrupted)
     {
-        return JS_TRUE;
+        pycx->interrupted = 0;
+        PyErr_SetString(JSInterrupted, "JavaScript execution was interrupted.");
+        return JS_FALSE;
     }
 
-    pycx->branch_count = 0;
+    if(pycx->timed_out)
+    {
+        PyErr_SetNone(PyExc_SystemError);
+        return JS_FALSE;
+    }
 
     if(pycx->max_heap > 0)
     {
@@ -328,17 +556,61 @@ branch_cb(JSContext* jscx)
 	}
     }
 
-    if(
-        pycx->max_time > 0
-        && pycx->start_time > 0
-        && pycx->max_time < now - pycx->start_time
-    )
+    return JS_TRUE;
+}
+
+/*
+    Called around every entry into JavaScript. The effective deadline
+    is the earliest of an enclosing execution's deadline, max_time for
+    the outermost execution and the timeout_ms of this call.
+*/
+int
+Context_push_deadline(Context* self, long timeout_ms, int64_t* saved)
+{
+    int64_t deadline = self->deadline;
+    int64_t now = 0;
+    int64_t limit;
+
+    *saved = deadline;
+
+    if(timeout_ms > 0 || (self->depth == 0 && self->max_time > 0))
     {
-        PyErr_SetNone(PyExc_SystemError);
-        return JS_FALSE;
+        now = Runtime_now_ms();
     }
 
-    return JS_TRUE;
+    if(self->depth == 0 && self->max_time > 0)
+    {
+        limit = now + ((int64_t) self->max_time) * 1000;
+        if(deadline == 0 || limit < deadline) deadline = limit;
+    }
+
+    if(timeout_ms > 0)
+    {
+        limit = now + timeout_ms;
+        if(deadline == 0 || limit < deadline) deadline = limit;
+    }
+
+    if(deadline != self->deadline)
+    {
+        if(!Runtime_set_deadline(self->rt, self, deadline)) return 0;
+    }
+
+    self->depth++;
+    return 1;
+}
+
+void
+Context_pop_deadline(Context* self, int64_t saved)
+{
+    self->depth--;
+
+    // An interrupt only ever applies to the script that was running.
+    if(self->depth == 0) self->interrupted = 0;
+
+    if(saved != self->deadline)
+    {
+        Runtime_set_deadline(self->rt, self, saved);
+    }
 }
 
 PyObject*
@@ -352,19 +624,22 @@ Context_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     PyObject* access = NULL;
     int strict = 0;
     int jit = 1;
+    int materialize = 0;
     uint32_t jsopts;
 
-    const char* keywords[] = {"runtime", "glbl", "access", "strict", "enable_jit", NULL};
+    const char* keywords[] = {"runtime", "glbl", "access", "strict", "enable_jit",
+                                "materialize", NULL};
 
     if(!PyArg_ParseTupleAndKeywords(
         args, kwargs,
-        "O!|OOI",
+        "O!|OOIii",
         (char **)keywords,	// Python headers need to change, then we should remove this
         RuntimeType, &runtime,
         &global,
         &access,
         &strict,
-	&jit
+	&jit,
+	&materialize
     )) goto error;
 
     if(global == Py_None) global = NULL;
@@ -397,16 +672,17 @@ Context_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
         goto error;
     }
 
+    if(runtime->thread != PyThread_get_thread_ident())
+    {
+        PyErr_SetString(JSError, "Runtime belongs to another thread.");
+        goto error;
+    }
+
     self = (Context*) type->tp_alloc(type, 0);
     if(self == NULL) goto error;
 
-    // Tracking what classes we've installed in
-    // the context.
-    self->classes = (PyDictObject*) PyDict_New();
-    if(self->classes == NULL) goto error;
 
-    self->objects = (PySetObject*) PySet_New(NULL);
-    if(self->objects == NULL) goto error;
+    HandleTable_init(&(self->objects));
 
     self->cx = JS_NewContext(runtime->rt, 8192);
     if(self->cx == NULL)
@@ -430,7 +706,14 @@ Context_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     JS_SetContextPrivate(self->cx, self);
 
     // Setup the root of the property lookup doodad.
-    self->root = JS_NewGlobalObject(self->cx, &js_global_class, nullptr);
+    if(materialize)
+    {
+        self->materialized = PySet_New(NULL);
+        if(self->materialized == NULL) goto error;
+    }
+
+    self->root = JS_NewGlobalObject(self->cx,
+            materialize ? &js_materialized_global_class : &js_global_class, nullptr);
     if(self->root == NULL)
     {
         PyErr_SetString(PyExc_RuntimeError, "Error creating root object.");
@@ -457,13 +740,24 @@ Context_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     self->access = access;
 
     // Setup counters for resource limits
-    self->branch_count = 0;
     self->max_time = 0;
-    self->start_time = 0;
     self->max_heap = 0;
-
-    // initial we are on the thread we are currently using
-    self->thread_active = 1;
+    self->deadline = 0;
+    self->timed_out = 0;
+    self->interrupted = 0;
+    self->watch_next = NULL;
+    self->depth = 0;
+
+    PtrMap_init(&(self->wrappers));
+    PtrMap_init(&(self->jsobjects));
+    RootArena_init(&(self->roots));
+    PtrMap_init(&(self->protos));
+    PtrMap_init(&(self->bound));
+    PtrMap_init(&(self->members));
+    PtrMap_init(&(self->misses));
+    KeyCache_init(&(self->keys));
+    PtrMap_init(&(self->policy.rules));
+    PtrMap_init(&(self->policy.memo));
 
     JS_SetOperationCallback(self->cx, branch_cb);
     JS_SetErrorReporter(self->cx, report_error_cb);
@@ -482,9 +776,13 @@ Context_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     }
 
     JS_SetOptions(self->cx, jsopts);
+
+    // Compile Ion code on the runtime's helper threads.
+    JS_SetParallelCompilationEnabled(self->cx, runtime->parallel_compilation && jit);
     
     Py_INCREF(runtime);
     self->rt = runtime;
+    Runtime_add_context(runtime, self);
 
     goto success;
 
@@ -509,21 +807,399 @@ Context_init(Context* self, PyObject* args, PyObject* kwargs)
 void
 Context_dealloc(Context* self)
 {
+    if (self->rt != NULL && self->deadline != 0)
+	Runtime_set_deadline(self->rt, self, 0);
+
+    // Our wrappers all hold a reference to us, so only prototypes
+    // are still rooted here.
+    if (self->rt != NULL)
+	Runtime_remove_context(self->rt, self);
+    RootArena_free(&(self->roots));
+    PtrMap_free(&(self->protos));
+    PtrMap_free(&(self->bound));
+
+    PtrMapEntry* entry;
+    PtrMap_FOREACH(&(self->members), entry)
+    {
+	MemberTable_free((MemberTable*) entry->value);
+    }
+    PtrMap_free(&(self->members));
+
     if (self->cx != NULL)
     {
+	if (self->snapshot != NULL)
+	    JS_RemoveObjectRoot(self->cx, &(self->snapshot));
+
+	// Wrapped Python objects may outlive us. Their finalizers
+	// take over our references instead of coming looking.
+	HandleEntry* entry;
+	HandleTable_FOREACH(&(self->objects), entry)
+	    JS_SetReservedSlot(entry->jsobj, 1, JSVAL_VOID);
+	HandleTable_free(&(self->objects));
+	PtrMap_free(&(self->jsobjects));
+
 	JS_LeaveCompartment(self->cx, self->orig_compartment);
         JS_DestroyContext(self->cx);
     }
 
 
     Py_CLEAR(self->err_reporter);
-    Py_CLEAR(self->objects);
     Py_CLEAR(self->weakglobal);
     Py_CLEAR(self->strongglobal);
     Py_CLEAR(self->access);
-    Py_CLEAR(self->classes);
+    Py_CLEAR(self->policy_spec);
+    Py_CLEAR(self->snapshot_access);
+    Py_CLEAR(self->snapshot_policy);
+    Py_CLEAR(self->snapshot_reporter);
+    Py_CLEAR(self->materialized);
+    Context_forget_misses(self);
+    PtrMap_free(&(self->misses));
+    KeyCache_free(&(self->keys));
+    AccessPolicy_clear(&(self->policy));
+
+    // Every wrapper holds a reference to us, so this is empty by now.
+    PtrMap_free(&(self->wrappers));
 
     Py_XDECREF(self->rt);
+
+    self->ob_type->tp_free((PyObject*) self);
+}
+
+// Attributes a snapshot keeps, accessors are captured by value.
+#define SNAPSHOT_ATTRS (JSPROP_ENUMERATE | JSPROP_READONLY | JSPROP_PERMANENT)
+
+/*
+    Copy every own property of the global, builtins and non-enumerable
+    ones included, into a rooted plain object with the same attributes.
+    As in Context_reset, the Python global is detached meanwhile.
+*/
+int
+Context_snapshot(Context* self)
+{
+    JSObject* snapshot = NULL;
+    PyObject* weakglobal = self->weakglobal;
+    PyObject* strongglobal = self->strongglobal;
+    JSPropertyOp getter;
+    JSStrictPropertyOp setter;
+    unsigned attrs;
+    JSBool found;
+    jsval val;
+    size_t i;
+    int ret = 0;
+
+    self->weakglobal = NULL;
+    self->strongglobal = NULL;
+
+    JS_BeginRequest(self->cx);
+
+    {
+        js::AutoIdVector ids(self->cx);
+
+        snapshot = JS_NewObject(self->cx, NULL, NULL, NULL);
+        if(snapshot == NULL)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to create snapshot object.");
+            goto done;
+        }
+
+        if(self->snapshot == NULL)
+        {
+            self->snapshot = snapshot;
+            if(!JS_AddNamedObjectRoot(self->cx, &(self->snapshot), "Context_snapshot"))
+            {
+                self->snapshot = NULL;
+                PyErr_SetString(PyExc_RuntimeError, "Failed to root snapshot.");
+                goto done;
+            }
+        }
+        else
+        {
+            self->snapshot = snapshot;
+        }
+
+        if(!js::GetPropertyNames(self->cx, self->root,
+                                    JSITER_OWNONLY | JSITER_HIDDEN, &ids))
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to enumerate global.");
+            goto done;
+        }
+
+        for(i = 0; i < ids.length(); i++)
+        {
+            if(!JS_GetPropertyAttrsGetterAndSetterById(self->cx, self->root,
+                    ids[i], &attrs, &found, &getter, &setter)
+                    || !JS_GetPropertyById(self->cx, self->root, ids[i], &val)
+                    || !JS_DefinePropertyById(self->cx, self->snapshot, ids[i],
+                            val, NULL, NULL, attrs & SNAPSHOT_ATTRS))
+            {
+                if(!PyErr_Occurred())
+                {
+                    PyErr_SetString(PyExc_RuntimeError, "Failed to copy global property.");
+                }
+                goto done;
+            }
+        }
+
+        Py_XINCREF(self->access);
+        Py_XSETREF(self->snapshot_access, self->access);
+        Py_XINCREF(self->policy_spec);
+        Py_XSETREF(self->snapshot_policy, self->policy_spec);
+        Py_XINCREF(self->err_reporter);
+        Py_XSETREF(self->snapshot_reporter, self->err_reporter);
+        self->snapshot_max_heap = self->max_heap;
+        self->snapshot_max_time = self->max_time;
+
+        ret = 1;
+    }
+
+done:
+    JS_EndRequest(self->cx);
+    self->weakglobal = weakglobal;
+    self->strongglobal = strongglobal;
+    return ret;
+}
+
+static int
+restore_settings(Context* self)
+{
+    if(self->policy_spec != self->snapshot_policy)
+    {
+        if(!AccessPolicy_set(&(self->policy),
+                self->snapshot_policy != NULL ? self->snapshot_policy : Py_None))
+            return 0;
+        Py_XINCREF(self->snapshot_policy);
+        Py_XSETREF(self->policy_spec, self->snapshot_policy);
+    }
+
+    Py_XINCREF(self->snapshot_access);
+    Py_XSETREF(self->access, self->snapshot_access);
+    Py_XINCREF(self->snapshot_reporter);
+    Py_XSETREF(self->err_reporter, self->snapshot_reporter);
+    self->max_heap = self->snapshot_max_heap;
+    self->max_time = self->snapshot_max_time;
+    return 1;
+}
+
+/*
+    Put the global back the way Context_snapshot found it. New
+    properties are deleted, or defined as undefined when they are
+    permanent (top level var and function declarations), and the
+    captured values and attributes are defined again, which also
+    undoes assignments to builtins. Objects reachable from those
+    values are not copied, so changes made to them survive. The
+    access handler and policy, error reporter and limits go back to
+    what they were too.
+
+    The Python global is detached meanwhile so the reset never
+    writes through to it.
+*/
+int
+Context_reset(Context* self)
+{
+    PyObject* weakglobal = self->weakglobal;
+    PyObject* strongglobal = self->strongglobal;
+    JSPropertyOp getter;
+    JSStrictPropertyOp setter;
+    unsigned attrs;
+    JSBool found;
+    jsval val;
+    size_t i;
+    int ret = 0;
+
+    if(self->snapshot == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Context has no snapshot.");
+        return 0;
+    }
+
+    self->weakglobal = NULL;
+    self->strongglobal = NULL;
+
+    JS_BeginRequest(self->cx);
+
+    {
+        js::AutoIdVector ids(self->cx);
+        js::AutoIdVector saved(self->cx);
+
+        if(!js::GetPropertyNames(self->cx, self->root,
+                                    JSITER_OWNONLY | JSITER_HIDDEN, &ids))
+            goto error;
+
+        for(i = 0; i < ids.length(); i++)
+        {
+            if(!JS_AlreadyHasOwnPropertyById(self->cx, self->snapshot, ids[i], &found))
+                goto error;
+            if(found) continue;
+
+            if(!JS_DeletePropertyById(self->cx, self->root, ids[i])) goto error;
+            if(!JS_AlreadyHasOwnPropertyById(self->cx, self->root, ids[i], &found))
+                goto error;
+            if(!found) continue;
+
+            // Defining, unlike assigning, also clears read-only ones.
+            if(!JS_DefinePropertyById(self->cx, self->root, ids[i], JSVAL_VOID,
+                                        NULL, NULL, JSPROP_PERMANENT))
+                goto error;
+        }
+
+        if(!js::GetPropertyNames(self->cx, self->snapshot,
+                                    JSITER_OWNONLY | JSITER_HIDDEN, &saved))
+            goto error;
+
+        for(i = 0; i < saved.length(); i++)
+        {
+            if(!JS_GetPropertyAttrsGetterAndSetterById(self->cx, self->snapshot,
+                    saved[i], &attrs, &found, &getter, &setter)
+                    || !JS_GetPropertyById(self->cx, self->snapshot, saved[i], &val)
+                    || !JS_DefinePropertyById(self->cx, self->root, saved[i],
+                            val, NULL, NULL, attrs & SNAPSHOT_ATTRS))
+                goto error;
+        }
+
+        if(!restore_settings(self)) goto error;
+
+        // Values materialized from the Python global may be stale.
+        if(Context_invalidate_key(self, NULL) < 0) goto error;
+
+        self->interrupted = 0;
+        ret = 1;
+        goto done;
+    }
+
+error:
+    if(JS_IsExceptionPending(self->cx)) JS_ClearPendingException(self->cx);
+    if(!PyErr_Occurred())
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to reset global object.");
+    }
+
+done:
+    JS_EndRequest(self->cx);
+    self->weakglobal = weakglobal;
+    self->strongglobal = strongglobal;
+    return ret;
+}
+
+/*
+    Define a materialized global again with the current Python value,
+    or undefined when the Python global no longer has it. The property
+    keeps its attributes.
+*/
+static int
+refresh_materialized(Context* self, PyObject* key, jsid kid)
+{
+    JSPropertyOp getter;
+    JSStrictPropertyOp setter;
+    unsigned attrs;
+    JSBool found;
+    JSBool defined;
+    jsval val = JSVAL_VOID;
+
+    CPyAutoObject global(get_cxglobal(self));
+    if(global.isNull()) return 1;
+
+    CPyAutoObject pyval(PyObject_GetItem(global, key));
+    if(pyval.isNull())
+    {
+        if(!PyErr_ExceptionMatches(PyExc_KeyError)) return 0;
+        PyErr_Clear();
+    }
+    else
+    {
+        val = py2js(self, pyval);
+        if(JSVAL_IS_VOID(val)) return 0;
+    }
+
+    if(!JS_GetPropertyAttrsGetterAndSetterById(self->cx, self->root, kid,
+                                            &attrs, &found, &getter, &setter))
+        return 0;
+
+    self->materializing = 1;
+    defined = JS_DefinePropertyById(self->cx, self->root, kid, val, NULL, NULL,
+                            attrs & (JSPROP_ENUMERATE | JSPROP_READONLY | JSPROP_PERMANENT));
+    self->materializing = 0;
+    return defined;
+}
+
+/*
+    Deletes the JS copy of a materialized global, or of all of them
+    when key is NULL. Returns how many were dropped, or -1.
+*/
+Py_ssize_t
+Context_invalidate_key(Context* self, PyObject* key)
+{
+    Py_ssize_t count = 0;
+    jsval deleted;
+    jsval jsk;
+    jsid kid;
+
+    Context_forget_misses(self);
+    if(self->materialized == NULL) return 0;
+
+    CPyAutoObject keys(key == NULL ? PySequence_List(self->materialized)
+                                   : PyList_New(0));
+    if(keys.isNull()) return -1;
+
+    if(key != NULL)
+    {
+        int found = PySet_Contains(self->materialized, key);
+        if(found < 0) return -1;
+        if(found && PyList_Append(keys, key) < 0) return -1;
+    }
+
+    JS_BeginRequest(self->cx);
+    self->invalidating = 1;
+
+    for(Py_ssize_t i = 0; i < PyList_GET_SIZE((PyObject*) keys); i++)
+    {
+        PyObject* item = PyList_GET_ITEM((PyObject*) keys, i);
+
+        jsk = py2js(self, item);
+        if(JSVAL_IS_VOID(jsk) || !JS_ValueToId(self->cx, jsk, &kid)
+                || !JS_DeletePropertyById2(self->cx, self->root, kid, &deleted))
+        {
+            count = -1;
+            break;
+        }
+
+        // var and function declarations are permanent and can't be
+        // deleted, so their copy is refreshed in place instead.
+        if(JSVAL_TO_BOOLEAN(deleted) ? PySet_Discard(self->materialized, item) < 0
+                                     : !refresh_materialized(self, item, kid))
+        {
+            count = -1;
+            break;
+        }
+        count++;
+    }
+
+    self->invalidating = 0;
+    if(count < 0 && JS_IsExceptionPending(self->cx))
+    {
+        JS_ClearPendingException(self->cx);
+    }
+    JS_EndRequest(self->cx);
+
+    if(count < 0 && !PyErr_Occurred())
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to invalidate global.");
+    }
+    return count;
+}
+
+PyObject*
+Context_invalidate(Context* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* key = NULL;
+    Py_ssize_t count;
+
+    if(!PyArg_ParseTuple(args, "|O", &key)) return NULL;
+    if(!Context_thread_OK(self)) return NULL;
+
+    count = Context_invalidate_key(self, key);
+    if(count < 0) return NULL;
+
+    return PyInt_FromSsize_t(count);
 }
 
 PyObject*
@@ -641,6 +1317,8 @@ Context_set_access(Context* self, PyObject* args, PyObject* kwargs)
     {
         Py_INCREF(newval);
         self->access = newval;
+        // Misses were only cached for names the old handler allowed.
+        Context_forget_misses(self);
     }
 
     if(ret == NULL)
@@ -653,6 +1331,18 @@ done:
     return ret;
 }
 
+PyObject*
+Context_set_access_policy(Context* self, PyObject* policy)
+{
+    PyObject* old = self->policy_spec;
+
+    if(!AccessPolicy_set(&(self->policy), policy)) return NULL;
+    self->policy_spec = policy == Py_None ? NULL : Py_INCREF_RET(policy);
+    Py_XDECREF(old);
+    Context_forget_misses(self);
+    Py_RETURN_NONE;
+}
+
 PyObject*
 Context_execute(Context* self, PyObject* args, PyObject* kwargs)
 {
@@ -661,41 +1351,56 @@ Context_execute(Context* self, PyObject* args, PyObject* kwargs)
     JSContext* cx = NULL;
     JSObject* root = NULL;
     JSString* script = NULL;
+    JSScript* compiled = NULL;
     const jschar* schars = NULL;
-    JSBool started_counter = JS_FALSE;
+    JSBool ok;
     const char *fname = "<anonymous JavaScript>";
     unsigned int lineno = 1;
+    long timeout_ms = 0;
+    int64_t saved_deadline;
     size_t slen;
     jsval rval;
 
-    const char *keywords[] = {"code", "filename", "lineno", NULL};
+    const char *keywords[] = {"code", "filename", "lineno", "timeout_ms", NULL};
 
-    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|sI", (char **)keywords,
-                                    &obj, (char *)&fname, &lineno))
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|sIl", (char **)keywords,
+                                    &obj, (char *)&fname, &lineno, &timeout_ms))
 	return NULL;
 
     if (!Context_thread_OK(self))
 	return NULL;
 
     JS_BeginRequest(self->cx);
-    
-    script = py2js_string_obj(self, obj);
-    if(script == NULL) goto error;
 
-    schars = JS_GetStringCharsZ(self->cx, script);
-    slen = JS_GetStringLength(script);
-    
     cx = self->cx;
     root = self->root;
 
-    // Mark us for time consumption
-    if(self->start_time == 0)
+    if(self->rt->scripts.size > 0)
     {
-        started_counter = JS_TRUE;
-        self->start_time = time(NULL);
+        compiled = ScriptCache_lookup(&(self->rt->scripts), self, obj, fname, lineno);
+        if(compiled == NULL) goto error;
+    }
+    else
+    {
+        script = py2js_string_obj(self, obj);
+        if(script == NULL) goto error;
+
+        schars = JS_GetStringCharsZ(self->cx, script);
+        slen = JS_GetStringLength(script);
     }
 
-    if(!JS_EvaluateUCScript(cx, root, schars, slen, fname, lineno, &rval))
+    if(!Context_push_deadline(self, timeout_ms, &saved_deadline)) goto error;
+
+    Py_BEGIN_ALLOW_THREADS
+    if(compiled != NULL)
+        ok = JS_ExecuteScript(cx, root, compiled, &rval);
+    else
+        ok = JS_EvaluateUCScript(cx, root, schars, slen, fname, lineno, &rval);
+    Py_END_ALLOW_THREADS
+
+    Context_pop_deadline(self, saved_deadline);
+
+    if(!ok)
     {
         if(!PyErr_Occurred())
         {
@@ -715,12 +1420,6 @@ Context_execute(Context* self, PyObject* args, PyObject* kwargs)
 error:
     JS_EndRequest(self->cx);
 success:
-
-    if(started_counter)
-    {
-        self->start_time = 0;
-    }
-
     return ret;
 }
 
@@ -749,6 +1448,7 @@ PyObject* Context_compile(Context* self, PyObject* args, PyObject* kwargs)
 {
     PyObject* obj = NULL;
     PyObject* ret = NULL;
+    PyObject* cache_path = NULL;
     JSContext* jcx = NULL;
     JSObject* root = NULL;
     JSString* script = NULL;
@@ -767,16 +1467,29 @@ PyObject* Context_compile(Context* self, PyObject* args, PyObject* kwargs)
     if (!Context_thread_OK(self))
 	return NULL;
 
-    JS_BeginRequest(self->cx);
+    jcx = self->cx;
+    root = self->root;
+
+    JS_BeginRequest(jcx);
+
+    if(self->rt->cache_dir != NULL)
+    {
+        cache_path = Compiled_cache_path(self, obj, fname, lineno);
+        if(cache_path == NULL) goto done;
+
+        rvalobj = Compiled_cache_load(self, cache_path);
+        if(rvalobj != NULL)
+        {
+            ret = Compiled_Wrap(self, rvalobj);
+            goto done;
+        }
+    }
     
     script = py2js_string_obj(self, obj);
-    if(script == NULL) goto error;
+    if(script == NULL) goto done;
 
-    schars = JS_GetStringCharsZ(self->cx, script);
+    schars = JS_GetStringCharsZ(jcx, script);
     slen = JS_GetStringLength(script);
-    
-    jcx = self->cx;
-    root = self->root;
 
     if(!(rvalobj = JS_CompileUCScript(jcx, root, schars, slen, fname, lineno)))
     {
@@ -784,39 +1497,124 @@ PyObject* Context_compile(Context* self, PyObject* args, PyObject* kwargs)
         {
             PyErr_SetString(PyExc_RuntimeError, "Script could not be compiled");
         }
-        goto error;
+        goto done;
     }
 
-    if(PyErr_Occurred()) goto error;
+    if(PyErr_Occurred()) goto done;
 
     ret = Compiled_Wrap(self, rvalobj);
+    if(ret == NULL) goto done;
 
-    JS_EndRequest(jcx);
-    JS_MaybeGC(jcx);
-    goto success;
+    if(cache_path != NULL) Compiled_cache_store(self, rvalobj, cache_path);
 
-error:
+done:
+    Py_XDECREF(cache_path);
     JS_EndRequest(jcx);
-success:
+    if(ret != NULL) JS_MaybeGC(jcx);
+    return ret;
+}
+
+PyObject*
+Context_loads(Context* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* ret = NULL;
+    JSScript* sobj = NULL;
+    const char* data = NULL;
+    int len = 0;
+
+    if(!PyArg_ParseTuple(args, "s#", &data, &len)) return NULL;
+
+    if(!Context_thread_OK(self)) return NULL;
+
+    JS_BeginRequest(self->cx);
+
+    sobj = Compiled_decode(self, data, len);
+    if(sobj == NULL) goto done;
+
+    ret = Compiled_Wrap(self, sobj);
+
+done:
+    JS_EndRequest(self->cx);
+    return ret;
+}
+
+PyObject*
+Context_handle_stats(Context* self, PyObject* args, PyObject* kwargs)
+{
+    return Py_BuildValue("{s:n,s:n,s:n,s:n}",
+        "live", self->objects.live,
+        "free", self->objects.capacity - self->objects.live,
+        "capacity", self->objects.capacity,
+        "roots", self->roots.live
+    );
+}
+
+PyObject*
+Context_to_js(Context* self, PyObject* args, PyObject* kwargs)
+{
+    static char* keywords[] = {"obj", "max_depth", NULL};
+    PyObject* obj = NULL;
+    PyObject* ret = NULL;
+    int max_depth = DEEPCONV_MAX_DEPTH;
+    jsval val;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", keywords,
+                                        &obj, &max_depth))
+    {
+        return NULL;
+    }
+
+    if(!Context_thread_OK(self)) return NULL;
+
+    JS_BeginRequest(self->cx);
 
+    val = py2js_deep(self, obj, max_depth);
+    if(!JSVAL_IS_VOID(val)) ret = js2py(self, val);
+
+    JS_EndRequest(self->cx);
     return ret;
 }
 
+PyObject*
+Context_key_cache_stats(Context* self, PyObject* args, PyObject* kwargs)
+{
+    return Py_BuildValue("{s:i,s:n,s:n}",
+        "slots", KEYCACHE_SLOTS,
+        "hits", self->keys.hits,
+        "misses", self->keys.misses
+    );
+}
+
 PyObject*
 Context_gc(Context* self, PyObject* args, PyObject* kwargs)
 {
     if (!Context_thread_OK(self))
 	return NULL;
 
-    Py_DECREF(self->objects);
-    self->objects = (PySetObject*) PySet_New(NULL);
-
     JS_GC(JS_GetRuntime(self->cx));
 
     Py_INCREF(self);
     return (PyObject*) self;
 }
 
+/*
+    May be called from any thread. There is no Context_thread_OK check
+    on purpose.
+*/
+PyObject*
+Context_interrupt(Context* self, PyObject* args, PyObject* kwargs)
+{
+    if(self->depth == 0)
+    {
+        Py_RETURN_FALSE;
+    }
+
+    self->interrupted = 1;
+    JS_TriggerOperationCallback(self->rt->rt);
+
+    Py_RETURN_TRUE;
+}
+
 PyObject*
 Context_max_memory(Context* self, PyObject* args, PyObject* kwargs)
 {
@@ -876,6 +1674,18 @@ static PyMethodDef Context_methods[] = {
         METH_VARARGS,
         "Set the access handler for wrapped python objects."
     },
+    {
+        "set_access_policy",
+        (PyCFunction)Context_set_access_policy,
+        METH_O,
+        "set_access_policy({type or None: rule})\n"
+        "Set access rules checked before the access handler. A rule is a "
+        "dict with optional 'allow' and 'deny' name lists, where 'name*' "
+        "matches a prefix, and 'call' and 'construct' booleans. Listing "
+        "allowed names denies the others; keys no rule decides go to the "
+        "access handler. None as a key applies to every other type, None "
+        "as the policy removes it."
+    },
     {
         "execute",
         (PyCFunction)Context_execute,
@@ -888,6 +1698,23 @@ static PyMethodDef Context_methods[] = {
         METH_VARARGS | METH_KEYWORDS,
         "Compile JavaScript source code."
     },
+    {
+        "loads",
+        (PyCFunction)Context_loads,
+        METH_VARARGS,
+        "Load bytecode produced by Compiled.dumps()."
+    },
+    {
+        "invalidate",
+        (PyCFunction)Context_invalidate,
+        METH_VARARGS,
+        "invalidate([key])\n"
+        "Drop the JavaScript copy of a global materialized from the Python "
+        "global, or of all of them, so the next use reads it again. Copies "
+        "made permanent by var or function declarations are refreshed in "
+        "place. Also forgets which names the global was found not to have. "
+        "Returns how many copies were dropped or refreshed."
+    },
     {
         "set_error_reporter",
         (PyCFunction)Context_set_error_reporter,
@@ -900,6 +1727,36 @@ static PyMethodDef Context_methods[] = {
         METH_VARARGS,
         "Force garbage collection of the JS context."
     },
+    {
+        "handle_stats",
+        (PyCFunction)Context_handle_stats,
+        METH_NOARGS,
+        "Return the number of live and free handles to Python objects, "
+        "and the number of JS values rooted by Python wrappers."
+    },
+    {
+        "to_js",
+        (PyCFunction)Context_to_js,
+        METH_VARARGS | METH_KEYWORDS,
+        "to_js(obj, max_depth=64)\n"
+        "Copy nested dicts, lists and tuples into plain JavaScript objects "
+        "and arrays in one pass, instead of wrapping them. Containers "
+        "reached more than once become the same object. Raises ValueError "
+        "for structures nested more than max_depth levels."
+    },
+    {
+        "key_cache_stats",
+        (PyCFunction)Context_key_cache_stats,
+        METH_NOARGS,
+        "Return the size of the property name caches and how often they hit."
+    },
+    {
+        "interrupt",
+        (PyCFunction)Context_interrupt,
+        METH_NOARGS,
+        "Abort the script currently running in this context. Safe to call "
+        "from any thread. Returns False if nothing was running."
+    },
     {
         "max_memory",
         (PyCFunction)Context_max_memory,
@@ -964,6 +1821,12 @@ Context_has_access(Context* pycx, JSContext* jscx, PyObject* obj, PyObject* key)
     PyObject* tmp = NULL;
     int res = -1;
 
+    if(AccessPolicy_ACTIVE(&(pycx->policy)))
+    {
+        res = AccessPolicy_check(&(pycx->policy), obj, key);
+        if(res != ACCESS_DEFER) goto done;
+    }
+
     if(pycx->access == NULL)
     {
         res = 1;
@@ -1003,28 +1866,14 @@ done:
     return res;
 }
 
-PyObject*
-Context_get_class(Context* cx, const char* key)
+Py_ssize_t
+Context_add_object(Context* cx, PyObject* val, JSObject* jsobj)
 {
-    return PyDict_GetItemString((PyObject*) cx->classes, key);
+    return HandleTable_add(&(cx->objects), val, jsobj);
 }
 
-int
-Context_add_class(Context* cx, const char* key, PyObject* val)
-{
-    return PyDict_SetItemString((PyObject*) cx->classes, key, val);
-}
-
-void 
-addobject_decref(void *ptr)
-{
-    PyObject* pyo = (PyObject*) ptr;
-    Py_DECREF(pyo);
-}
-
-int
-Context_add_object(Context* cx, PyObject* val)
+void
+Context_release_object(Context* cx, Py_ssize_t handle)
 {
-    PyObject* wrapped = HashCObj_FromVoidPtr(val, addobject_decref);
-    return PySet_Add((PyObject*) cx->objects, wrapped);
+    HandleTable_release(&(cx->objects), handle);
 }
@@ -14,7 +14,7 @@
 
 #include "spidermonkey.h"
 
-typedef struct {
+typedef struct Context {
     PyObject_HEAD
     Runtime* rt;
 
@@ -28,25 +28,90 @@ typedef struct {
     PyObject* strongglobal;
 
     PyObject* access;
+    AccessPolicy policy;    // Checked before access, see set_access_policy.
+    PyObject* policy_spec;  // The dict policy was set from, or NULL.
+
+    // Keys of the Python global copied into data properties on root,
+    // or NULL unless created with materialize=True.
+    PyObject* materialized;
+    char materializing;
+    char invalidating;
+
+    // Names the resolve hooks found missing from a dict global, keyed
+    // by the bits of their atom's jsid, holding the converted key. A GC
+    // only marks them stale, since atoms can be freed and the GIL may
+    // not be held; they are dropped on next use.
+    PtrMap misses;
+    char misses_stale;
+
+    // Property names converted in either direction. See js2py_key.
+    KeyCache keys;
     PyObject* err_reporter;
     JSContext* cx;
     JSObject* root;
-    PyDictObject* classes;
-    PySetObject* objects;
-    PySetObject* root_objects;
-    unsigned int branch_count;
+    HandleTable objects;    // Python objects referenced from JavaScript
     long max_heap;
     time_t max_time;
-    time_t start_time;
-    char thread_active;
+
+    // Execution deadline in milliseconds (0 for none), guarded by the
+    // runtime's watch_lock. timed_out is raised by the watchdog thread.
+    int64_t deadline;
+    volatile char timed_out;
+    volatile char interrupted;
+    struct Context* watch_next;
+    int depth;
     JSCompartment* orig_compartment;
+
+    // Own properties of the global captured by Context_snapshot,
+    // restored by Context_reset. See ContextPool.
+    JSObject* snapshot;
+    // Settings captured with it, so a lease can't hand changes to the
+    // access checks, error reporter or limits on to the next one.
+    PyObject* snapshot_access;
+    PyObject* snapshot_policy;
+    PyObject* snapshot_reporter;
+    long snapshot_max_heap;
+    time_t snapshot_max_time;
+
+    // JSObject* -> the live PJObject wrapping it, so converting the
+    // same object twice yields the same proxy. Wrappers remove
+    // themselves on dealloc; they root their object meanwhile.
+    PtrMap wrappers;
+
+    // The reverse: PyObject* -> the JSObject wrapping it. Entries are
+    // dropped by js_finalize, which finds us through reserved slot 1
+    // and releases the handle in slot 2.
+    PtrMap jsobjects;
+
+    // Roots for our wrappers and prototypes, traced by the runtime.
+    RootArena roots;
+
+    // PyTypeObject* -> rooted slot holding the prototype for its
+    // wrappers. The Runtime keeps the types alive.
+    PtrMap protos;
+
+    // PyTypeObject* -> the Binding its prototype was built from. The
+    // bound accessors look the wrapped object's type up here.
+    PtrMap bound;
+
+    // PyTypeObject* -> MemberTable of the accessors on its prototype.
+    PtrMap members;
+    struct Context* rt_next;
 } Context;
 
-PyObject* Context_get_class(Context* cx, const char* key);
-int Context_add_class(Context* cx, const char* key, PyObject* val);
 int Context_has_access(Context*, JSContext*, PyObject*, PyObject*);
-int Context_add_object(Context* cx, PyObject* val);
+// Whether Context_has_access can say no, so callers can skip making keys.
+#define Context_CHECKS_ACCESS(cx) \
+    ((cx)->access != NULL || AccessPolicy_ACTIVE(&((cx)->policy)))
+Py_ssize_t Context_add_object(Context* cx, PyObject* val, JSObject* jsobj);
+void Context_release_object(Context* cx, Py_ssize_t handle);
 char Context_thread_OK(Context* cs);
+int Context_push_deadline(Context* cx, long timeout_ms, int64_t* saved);
+void Context_pop_deadline(Context* cx, int64_t saved);
+int Context_snapshot(Context* cx);
+int Context_reset(Context* cx);
+Py_ssize_t Context_invalidate_key(Context* cx, PyObject* key);
+void Context_forget_misses(Context* cx);
 
 extern PyTypeObject _ContextType;
 
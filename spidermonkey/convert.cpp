@@ -48,6 +48,49 @@ py2js(Context* cx, PyObject* obj)
     return JSVAL_VOID;
 }
 
+// Longer names are rare and not worth interning.
+#define KEY_INTERN_MAX 64
+
+PyObject*
+js2py_key(Context* cx, jsid id)
+{
+    char buf[KEY_INTERN_MAX];
+    const jschar* chars = NULL;
+    PyObject* ret = NULL;
+    size_t len = 0;
+    size_t i;
+    jsval val;
+
+    if(JSID_IS_INT(id)) return PyInt_FromLong(JSID_TO_INT(id));
+
+    ret = KeyCache_to_py(cx, id);
+    if(ret != NULL) return ret;
+
+    if(JSID_IS_STRING(id))
+    {
+        chars = JS_GetStringCharsAndLength(cx->cx, JSID_TO_STRING(id), &len);
+        if(chars != NULL && len <= KEY_INTERN_MAX)
+        {
+            for(i = 0; i < len && chars[i] < 128; i++) buf[i] = (char) chars[i];
+            if(i == len)
+            {
+                ret = PyString_FromStringAndSize(buf, len);
+                if(ret == NULL) return NULL;
+                PyString_InternInPlace(&ret);
+                KeyCache_remember(cx, ret, id);
+                return ret;
+            }
+        }
+    }
+
+    if(!JS_IdToValue(cx->cx, id, &val))
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to convert property id.");
+        return NULL;
+    }
+    return js2py(cx, val);
+}
+
 PyObject*
 js2py(Context* cx, jsval val)
 {
@@ -12,5 +12,8 @@
 jsval py2js(Context* cx, PyObject* obj);
 PyObject* js2py(Context* cx, JS::Value val);
 PyObject* js2py_with_parent(Context* cx, JS::Value val, JS::Value parent);
+// Property keys for dict lookups: ints, interned str for short ASCII
+// names, unicode otherwise.
+PyObject* js2py_key(Context* cx, jsid id);
 
 #endif
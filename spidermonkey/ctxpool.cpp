@@ -0,0 +1,278 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+static PyObject*
+ContextPool_make(ContextPool* self)
+{
+    PyObject* ret = NULL;
+    PyObject* cx = NULL;
+    PyObject* tmp = NULL;
+
+    cx = PyObject_CallFunctionObjArgs((PyObject*) ContextType, (PyObject*) self->rt,
+                                        self->global, self->access, NULL);
+    if(cx == NULL) goto error;
+
+    if(self->bootstrap != Py_None)
+    {
+        if(PyObject_TypeCheck(self->bootstrap, CompiledType))
+            tmp = PyObject_CallMethod(self->bootstrap, "execute", "O", cx);
+        else
+            tmp = PyObject_CallMethod(cx, "execute", "O", self->bootstrap);
+        if(tmp == NULL) goto error;
+        Py_DECREF(tmp);
+    }
+
+    if(!Context_snapshot((Context*) cx)) goto error;
+
+    ret = cx;
+    goto success;
+
+error:
+    Py_XDECREF(cx);
+success:
+    return ret;
+}
+
+PyObject*
+ContextPool_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    ContextPool* self = NULL;
+    Runtime* runtime = NULL;
+    PyObject* bootstrap = Py_None;
+    PyObject* global = Py_None;
+    PyObject* access = Py_None;
+    PyObject* cx = NULL;
+    Py_ssize_t size = 0;
+    Py_ssize_t i;
+
+    const char* keywords[] = {"runtime", "size", "bootstrap", "glbl", "access", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(
+        args, kwargs,
+        "O!n|OOO",
+        (char **)keywords,
+        RuntimeType, &runtime,
+        &size,
+        &bootstrap,
+        &global,
+        &access
+    )) goto error;
+
+    if(size < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Pool size must not be negative.");
+        goto error;
+    }
+
+    if(bootstrap != Py_None && !PyObject_TypeCheck(bootstrap, CompiledType)
+            && !PyString_Check(bootstrap) && !PyUnicode_Check(bootstrap))
+    {
+        PyErr_SetString(PyExc_TypeError, "Bootstrap must be a script or Compiled object.");
+        goto error;
+    }
+
+    self = (ContextPool*) type->tp_alloc(type, 0);
+    if(self == NULL) goto error;
+
+    Py_INCREF(runtime);
+    self->rt = runtime;
+    self->bootstrap = Py_INCREF_RET(bootstrap);
+    self->global = Py_INCREF_RET(global);
+    self->access = Py_INCREF_RET(access);
+    self->size = size;
+
+    self->idle = PyList_New(0);
+    if(self->idle == NULL) goto error;
+
+    self->leased = PySet_New(NULL);
+    if(self->leased == NULL) goto error;
+
+    // Pay for the bootstrap up front.
+    for(i = 0; i < size; i++)
+    {
+        cx = ContextPool_make(self);
+        if(cx == NULL) goto error;
+
+        if(PyList_Append(self->idle, cx) < 0) goto error;
+        Py_CLEAR(cx);
+    }
+
+    goto success;
+
+error:
+    Py_XDECREF(cx);
+    Py_XDECREF(self);
+    self = NULL;
+
+success:
+    return (PyObject*) self;
+}
+
+void
+ContextPool_dealloc(ContextPool* self)
+{
+    Py_XDECREF(self->idle);
+    Py_XDECREF(self->leased);
+    Py_XDECREF(self->bootstrap);
+    Py_XDECREF(self->global);
+    Py_XDECREF(self->access);
+    Py_XDECREF(self->rt);
+
+    self->ob_type->tp_free((PyObject*) self);
+}
+
+PyObject*
+ContextPool_acquire(ContextPool* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* cx = NULL;
+    Py_ssize_t n;
+
+    if(self->rt->thread != PyThread_get_thread_ident())
+    {
+        PyErr_SetString(JSError, "Runtime belongs to another thread.");
+        return NULL;
+    }
+
+    n = PyList_GET_SIZE(self->idle);
+    if(n > 0)
+    {
+        cx = Py_INCREF_RET(PyList_GET_ITEM(self->idle, n - 1));
+        if(PyList_SetSlice(self->idle, n - 1, n, NULL) < 0) goto error;
+    }
+    else
+    {
+        // Exhausted, so the caller pays for a fresh one.
+        cx = ContextPool_make(self);
+        if(cx == NULL) goto error;
+    }
+
+    if(PySet_Add(self->leased, cx) < 0) goto error;
+
+    return cx;
+
+error:
+    Py_XDECREF(cx);
+    return NULL;
+}
+
+PyObject*
+ContextPool_release(ContextPool* self, PyObject* cx)
+{
+    int found;
+
+    if(self->rt->thread != PyThread_get_thread_ident())
+    {
+        PyErr_SetString(JSError, "Runtime belongs to another thread.");
+        return NULL;
+    }
+
+    found = PySet_Discard(self->leased, cx);
+    if(found < 0) return NULL;
+    if(found == 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Context was not acquired from this pool.");
+        return NULL;
+    }
+
+    if(PyList_GET_SIZE(self->idle) >= self->size)
+    {
+        Py_RETURN_NONE;
+    }
+
+    // A context that can't be reset is dropped instead of reused.
+    if(!Context_reset((Context*) cx)) return NULL;
+
+    if(PyList_Append(self->idle, cx) < 0) return NULL;
+
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+ContextPool_get_size(ContextPool* self, void* closure)
+{
+    return PyInt_FromSsize_t(self->size);
+}
+
+static PyObject*
+ContextPool_get_idle(ContextPool* self, void* closure)
+{
+    return PyInt_FromSsize_t(PyList_GET_SIZE(self->idle));
+}
+
+static PyObject*
+ContextPool_get_leased(ContextPool* self, void* closure)
+{
+    return PyInt_FromSsize_t(PySet_GET_SIZE(self->leased));
+}
+
+static PyMethodDef ContextPool_methods[] = {
+    {
+        "acquire",
+        (PyCFunction)ContextPool_acquire,
+        METH_NOARGS,
+        "Take a bootstrapped Context from the pool."
+    },
+    {
+        "release",
+        (PyCFunction)ContextPool_release,
+        METH_O,
+        "Reset a Context and return it to the pool."
+    },
+    {NULL}
+};
+
+static PyGetSetDef ContextPool_getset[] = {
+    {(char*)"size", (getter)ContextPool_get_size, NULL, (char*)"Number of contexts kept warm.", NULL},
+    {(char*)"idle", (getter)ContextPool_get_idle, NULL, (char*)"Number of contexts ready for use.", NULL},
+    {(char*)"leased", (getter)ContextPool_get_leased, NULL, (char*)"Number of contexts handed out.", NULL},
+    {NULL}
+};
+
+PyTypeObject _ContextPoolType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "spidermonkey.ContextPool",                 /*tp_name*/
+    sizeof(ContextPool),                        /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)ContextPool_dealloc,            /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash*/
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    "Pool of bootstrapped JavaScript contexts", /*tp_doc*/
+    0,		                                    /*tp_traverse*/
+    0,		                                    /*tp_clear*/
+    0,		                                    /*tp_richcompare*/
+    0,		                                    /*tp_weaklistoffset*/
+    0,		                                    /*tp_iter*/
+    0,		                                    /*tp_iternext*/
+    ContextPool_methods,                        /*tp_methods*/
+    0,                                          /*tp_members*/
+    ContextPool_getset,                         /*tp_getset*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    0,                                          /*tp_init*/
+    0,                                          /*tp_alloc*/
+    ContextPool_new,                            /*tp_new*/
+};
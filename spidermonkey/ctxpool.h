@@ -0,0 +1,34 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_CTXPOOL_H
+#define PYSM_CTXPOOL_H
+
+/*
+    Contexts of one Runtime, bootstrapped once and handed out
+    repeatedly. Released contexts get their global reset to the
+    state it had right after the bootstrap.
+*/
+
+#include <Python.h>
+#include "structmember.h"
+
+typedef struct {
+    PyObject_HEAD
+    Runtime* rt;
+    PyObject* bootstrap;
+    PyObject* global;
+    PyObject* access;
+    PyObject* idle;         // list of reset contexts
+    PyObject* leased;       // set of contexts handed out
+    Py_ssize_t size;
+} ContextPool;
+
+extern PyTypeObject _ContextPoolType;
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+/*
+    Containers are filled from an explicit stack rather than by
+    recursion, so deep trees don't exhaust the C stack. Each new JavaScript object
+    is stored on its parent before it is filled, keeping everything
+    reachable from the root while allocations may trigger a GC.
+*/
+
+typedef struct {
+    PyObject* obj;
+    JSObject* jsobj;
+    int depth;
+} DeepItem;
+
+typedef struct {
+    Context* cx;
+    PtrMap seen;        // PyObject* -> JSObject*
+    DeepItem* stack;
+    size_t count;
+    size_t capacity;
+    int max_depth;
+} DeepState;
+
+static int
+is_container(PyObject* obj)
+{
+    return PyDict_CheckExact(obj) || PyList_CheckExact(obj)
+                || PyTuple_CheckExact(obj);
+}
+
+static int
+push(DeepState* st, PyObject* obj, JSObject* jsobj, int depth)
+{
+    DeepItem* stack = NULL;
+    size_t capacity;
+
+    if(st->count == st->capacity)
+    {
+        capacity = st->capacity ? st->capacity * 2 : 16;
+        stack = (DeepItem*) realloc(st->stack, capacity * sizeof(DeepItem));
+        if(stack == NULL)
+        {
+            PyErr_NoMemory();
+            return 0;
+        }
+        st->stack = stack;
+        st->capacity = capacity;
+    }
+
+    st->stack[st->count].obj = obj;
+    st->stack[st->count].jsobj = jsobj;
+    st->stack[st->count].depth = depth;
+    st->count++;
+    return 1;
+}
+
+// Returns the JavaScript value for a member of a container at depth.
+static jsval
+convert(DeepState* st, PyObject* obj, int depth)
+{
+    JSObject* jsobj = NULL;
+
+    if(!is_container(obj)) return py2js(st->cx, obj);
+
+    jsobj = (JSObject*) PtrMap_get(&(st->seen), obj);
+    if(jsobj != NULL) return OBJECT_TO_JSVAL(jsobj);
+
+    if(depth > st->max_depth)
+    {
+        PyErr_Format(PyExc_ValueError,
+            "Python value is nested more than %d levels deep.", st->max_depth);
+        return JSVAL_VOID;
+    }
+
+    if(PyDict_CheckExact(obj))
+    {
+        jsobj = JS_NewObject(st->cx->cx, NULL, NULL, NULL);
+    }
+    else
+    {
+        jsobj = JS_NewArrayObject(st->cx->cx, 0, NULL);
+    }
+
+    if(jsobj == NULL)
+    {
+        if(!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to create JS object.");
+        }
+        return JSVAL_VOID;
+    }
+
+    if(!PtrMap_put(&(st->seen), obj, jsobj))
+    {
+        PyErr_NoMemory();
+        return JSVAL_VOID;
+    }
+
+    if(!push(st, obj, jsobj, depth)) return JSVAL_VOID;
+
+    return OBJECT_TO_JSVAL(jsobj);
+}
+
+static int
+fill_dict(DeepState* st, DeepItem* item)
+{
+    PyObject* key = NULL;
+    PyObject* value = NULL;
+    Py_ssize_t pos = 0;
+    jsval val;
+    jsid id;
+
+    while(PyDict_Next(item->obj, &pos, &key, &value))
+    {
+        if(!PyString_Check(key) && !PyUnicode_Check(key)
+                && !PyInt_Check(key) && !PyLong_Check(key))
+        {
+            PyErr_SetString(PyExc_TypeError,
+                "Only string and integer keys can be converted to JS.");
+            return 0;
+        }
+
+        if(!KeyCache_to_id(st->cx, key, &id)) return 0;
+
+        val = convert(st, value, item->depth + 1);
+        if(JSVAL_IS_VOID(val)) return 0;
+
+        if(!JS_DefinePropertyById(st->cx->cx, item->jsobj, id, val,
+                                    NULL, NULL, JSPROP_ENUMERATE))
+        {
+            if(!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_RuntimeError, "Failed to set property.");
+            }
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+fill_seq(DeepState* st, DeepItem* item)
+{
+    PyObject* seq = item->obj;
+    Py_ssize_t idx;
+    jsval val;
+
+    // A finalizer run by the GC could resize the list, so its size
+    // and items are read again on every pass.
+    for(idx = 0; idx < PySequence_Fast_GET_SIZE(seq); idx++)
+    {
+        val = convert(st, PySequence_Fast_GET_ITEM(seq, idx), item->depth + 1);
+        if(JSVAL_IS_VOID(val)) return 0;
+
+        if(!JS_DefineElement(st->cx->cx, item->jsobj, (uint32_t) idx, val,
+                                NULL, NULL, JSPROP_ENUMERATE))
+        {
+            if(!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_RuntimeError, "Failed to set element.");
+            }
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+jsval
+py2js_deep(Context* cx, PyObject* obj, int max_depth)
+{
+    DeepState st;
+    DeepItem item;
+    jsval* root = NULL;
+    jsval ret = JSVAL_VOID;
+    int ok;
+
+    if(!is_container(obj)) return py2js(cx, obj);
+
+    st.cx = cx;
+    PtrMap_init(&(st.seen));
+    st.stack = NULL;
+    st.count = 0;
+    st.capacity = 0;
+    st.max_depth = max_depth;
+
+    ret = convert(&st, obj, 1);
+    if(JSVAL_IS_VOID(ret)) goto error;
+
+    root = RootArena_add(&(cx->roots), ret);
+    if(root == NULL) goto error;
+
+    while(st.count > 0)
+    {
+        item = st.stack[--st.count];
+
+        if(PyDict_CheckExact(item.obj))
+        {
+            ok = fill_dict(&st, &item);
+        }
+        else
+        {
+            ok = fill_seq(&st, &item);
+        }
+
+        if(!ok) goto error;
+    }
+
+    goto success;
+
+error:
+    ret = JSVAL_VOID;
+success:
+    if(root != NULL) RootArena_release(&(cx->roots), root);
+    PtrMap_free(&(st.seen));
+    free(st.stack);
+    return ret;
+}
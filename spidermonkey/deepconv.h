@@ -0,0 +1,28 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_DEEPCONV_H
+#define PYSM_DEEPCONV_H
+
+/*
+    Eager conversion of a tree of exact dicts, lists and tuples into
+    plain JavaScript objects and arrays. JavaScript then reads them
+    without calling back into Python, but the copy no longer follows
+    changes to the Python side. A container reached twice becomes the
+    same JavaScript object, which also covers cycles. Anything else is
+    converted as py2js would.
+*/
+
+#define DEEPCONV_MAX_DEPTH 64
+
+struct Context;
+
+// Returns JSVAL_VOID with an exception set on failure.
+jsval py2js_deep(struct Context* cx, PyObject* obj, int max_depth);
+
+#endif
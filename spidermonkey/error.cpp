@@ -142,6 +142,8 @@ success:
 void
 report_error_cb(JSContext* cx, const char* message, JSErrorReport* report)
 {
+    CPyAutoGIL gil;
+
     /* Subtle note about JSREPORT_EXCEPTION: it triggers whenever exceptions
      * are raised, even if they're caught and the Mozilla docs say you can
      * ignore it.
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+// Enough for a script returning a few thousand objects at once.
+#define FREELIST_MAX 1024
+
+typedef struct {
+    PyTypeObject** type;
+    PyObject* head;         // Chained through ob_type, like CPython's own.
+    int count;
+    unsigned long allocs;
+    unsigned long reuses;
+    unsigned long releases;
+} FreeList;
+
+static FreeList freelists[] = {
+    {&PJObjectType},
+    {&ArrayType},
+    {&FunctionType},
+    {&IteratorType},
+    {&CompiledType},
+};
+
+#define NUM_FREELISTS ((int) (sizeof(freelists) / sizeof(FreeList)))
+
+static FreeList*
+find_freelist(PyTypeObject* type)
+{
+    int i;
+
+    for(i = 0; i < NUM_FREELISTS; i++)
+    {
+        if(*(freelists[i].type) == type) return &(freelists[i]);
+    }
+
+    return NULL;
+}
+
+PyObject*
+FreeList_Alloc(PyTypeObject* type)
+{
+    FreeList* fl = find_freelist(type);
+    PyObject* ret = NULL;
+
+    if(fl == NULL) return type->tp_alloc(type, 0);
+
+    if(fl->head != NULL)
+    {
+        ret = fl->head;
+        fl->head = (PyObject*) Py_TYPE(ret);
+        fl->count--;
+        fl->reuses++;
+    }
+    else
+    {
+        ret = (PyObject*) PyObject_MALLOC(type->tp_basicsize);
+        if(ret == NULL) return PyErr_NoMemory();
+    }
+
+    fl->allocs++;
+    memset(ret, 0, type->tp_basicsize);
+    return PyObject_INIT(ret, type);
+}
+
+void
+FreeList_Release(PyObject* obj)
+{
+    FreeList* fl = find_freelist(Py_TYPE(obj));
+
+    if(fl == NULL || fl->count >= FREELIST_MAX)
+    {
+        Py_TYPE(obj)->tp_free(obj);
+        return;
+    }
+
+    Py_TYPE(obj) = (PyTypeObject*) fl->head;
+    fl->head = obj;
+    fl->count++;
+    fl->releases++;
+}
+
+PyObject*
+FreeList_stats(PyObject* self, PyObject* args)
+{
+    PyObject* ret = NULL;
+    PyObject* item = NULL;
+    int i;
+
+    ret = PyDict_New();
+    if(ret == NULL) return NULL;
+
+    for(i = 0; i < NUM_FREELISTS; i++)
+    {
+        FreeList* fl = &(freelists[i]);
+
+        item = Py_BuildValue("{s:k,s:k,s:k,s:i}",
+            "allocs", fl->allocs,
+            "reuses", fl->reuses,
+            "releases", fl->releases,
+            "cached", fl->count
+        );
+        if(item == NULL) goto error;
+
+        if(PyDict_SetItemString(ret, (*(fl->type))->tp_name, item) < 0) goto error;
+        Py_CLEAR(item);
+    }
+
+    return ret;
+
+error:
+    Py_XDECREF(item);
+    Py_XDECREF(ret);
+    return NULL;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_FREELIST_H
+#define PYSM_FREELIST_H
+
+/*
+    Recycled memory for the wrapper types created on every trip
+    across the bridge. Only exact instances are recycled; subclasses
+    go through their own tp_alloc and tp_free. All of this runs with
+    the GIL held.
+*/
+
+// Returns a zeroed, initialized instance of type.
+PyObject* FreeList_Alloc(PyTypeObject* type);
+// Called last from tp_dealloc in place of tp_free.
+void FreeList_Release(PyObject* obj);
+// Per type allocation counters, see spidermonkey.alloc_stats().
+PyObject* FreeList_stats(PyObject* self, PyObject* args);
+
+#endif
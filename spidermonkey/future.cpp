@@ -0,0 +1,257 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+#include <sys/time.h>
+
+Future*
+Future_New(void)
+{
+    Future* self = PyObject_NEW(Future, FutureType);
+    if(self == NULL) return NULL;
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    self->done = 0;
+    self->result = NULL;
+    self->exc_type = NULL;
+    self->exc_value = NULL;
+    self->exc_tb = NULL;
+
+    return self;
+}
+
+static void
+Future_finish(Future* self)
+{
+    pthread_mutex_lock(&self->lock);
+    self->done = 1;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+}
+
+void
+Future_set_result(Future* self, PyObject* result)
+{
+    Py_INCREF(result);
+    self->result = result;
+    Future_finish(self);
+}
+
+void
+Future_set_exception(Future* self)
+{
+    PyErr_Fetch(&self->exc_type, &self->exc_value, &self->exc_tb);
+    if(self->exc_type == NULL)
+    {
+        self->exc_type = PyExc_RuntimeError;
+        Py_INCREF(self->exc_type);
+    }
+    Future_finish(self);
+}
+
+/*
+    Block until the job finished or the timeout (in seconds, negative
+    meaning forever) expired. Called with the GIL held, waits without it.
+*/
+static int
+Future_wait(Future* self, double timeout)
+{
+    struct timeval now;
+    struct timespec until;
+    int done;
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->lock);
+
+    if(timeout < 0)
+    {
+        while(!self->done) pthread_cond_wait(&self->cond, &self->lock);
+    }
+    else if(!self->done)
+    {
+        gettimeofday(&now, NULL);
+        until.tv_sec = now.tv_sec + (time_t) timeout;
+        until.tv_nsec = now.tv_usec * 1000
+                            + (long) ((timeout - (time_t) timeout) * 1e9);
+        if(until.tv_nsec >= 1000000000)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+
+        while(!self->done)
+        {
+            if(pthread_cond_timedwait(&self->cond, &self->lock, &until) != 0)
+                break;
+        }
+    }
+
+    done = self->done;
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+
+    if(!done)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Timed out waiting for the result.");
+    }
+
+    return done;
+}
+
+void
+Future_dealloc(Future* self)
+{
+    Py_XDECREF(self->result);
+    Py_XDECREF(self->exc_type);
+    Py_XDECREF(self->exc_value);
+    Py_XDECREF(self->exc_tb);
+
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+
+    PyObject_Del(self);
+}
+
+PyObject*
+Future_done(Future* self, PyObject* args, PyObject* kwargs)
+{
+    int done;
+
+    pthread_mutex_lock(&self->lock);
+    done = self->done;
+    pthread_mutex_unlock(&self->lock);
+
+    return PyBool_FromLong(done);
+}
+
+PyObject*
+Future_result(Future* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* timeout = Py_None;
+    double secs = -1;
+
+    const char* keywords[] = {"timeout", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", (char **)keywords,
+                                    &timeout))
+        return NULL;
+
+    if(timeout != Py_None)
+    {
+        secs = PyFloat_AsDouble(timeout);
+        if(secs == -1 && PyErr_Occurred()) return NULL;
+    }
+
+    if(!Future_wait(self, secs)) return NULL;
+
+    if(self->exc_type != NULL)
+    {
+        Py_INCREF(self->exc_type);
+        Py_XINCREF(self->exc_value);
+        Py_XINCREF(self->exc_tb);
+        PyErr_Restore(self->exc_type, self->exc_value, self->exc_tb);
+        return NULL;
+    }
+
+    Py_INCREF(self->result);
+    return self->result;
+}
+
+PyObject*
+Future_exception(Future* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* timeout = Py_None;
+    PyObject* type = NULL;
+    PyObject* value = NULL;
+    PyObject* tb = NULL;
+    double secs = -1;
+
+    const char* keywords[] = {"timeout", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", (char **)keywords,
+                                    &timeout))
+        return NULL;
+
+    if(timeout != Py_None)
+    {
+        secs = PyFloat_AsDouble(timeout);
+        if(secs == -1 && PyErr_Occurred()) return NULL;
+    }
+
+    if(!Future_wait(self, secs)) return NULL;
+
+    if(self->exc_type == NULL) Py_RETURN_NONE;
+
+    type = self->exc_type;
+    value = self->exc_value;
+    tb = self->exc_tb;
+    Py_INCREF(type);
+    Py_XINCREF(value);
+    Py_XINCREF(tb);
+    PyErr_NormalizeException(&type, &value, &tb);
+
+    Py_XDECREF(type);
+    Py_XDECREF(tb);
+    return value;
+}
+
+static PyMethodDef Future_methods[] = {
+    {
+        "done",
+        (PyCFunction)Future_done,
+        METH_NOARGS,
+        "Return True if the job has finished."
+    },
+    {
+        "result",
+        (PyCFunction)Future_result,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wait for and return the job's result, re-raising its exception."
+    },
+    {
+        "exception",
+        (PyCFunction)Future_exception,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wait for the job and return the exception it raised, if any."
+    },
+    {NULL}
+};
+
+PyTypeObject _FutureType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "spidermonkey.Future",                      /*tp_name*/
+    sizeof(Future),                             /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)Future_dealloc,                 /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash*/
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    "Result of a job submitted to a Pool",      /*tp_doc*/
+    0,		                                    /*tp_traverse*/
+    0,		                                    /*tp_clear*/
+    0,		                                    /*tp_richcompare*/
+    0,		                                    /*tp_weaklistoffset*/
+    0,		                                    /*tp_iter*/
+    0,		                                    /*tp_iternext*/
+    Future_methods,                             /*tp_methods*/
+};
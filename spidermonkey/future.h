@@ -0,0 +1,41 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_FUTURE_H
+#define PYSM_FUTURE_H
+
+/*
+    The eventual result of a job submitted to a Pool.
+*/
+
+#include <Python.h>
+#include "structmember.h"
+
+#include <pthread.h>
+
+typedef struct {
+    PyObject_HEAD
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+    PyObject* result;
+    PyObject* exc_type;
+    PyObject* exc_value;
+    PyObject* exc_tb;
+} Future;
+
+extern PyTypeObject _FutureType;
+
+Future* Future_New(void);
+
+// Both of these must be called with the GIL held.  Set_exception consumes
+// the currently raised Python exception.
+void Future_set_result(Future* self, PyObject* result);
+void Future_set_exception(Future* self);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+#define HANDLES_MIN_CAPACITY 64
+
+void
+HandleTable_init(HandleTable* table)
+{
+    table->entries = NULL;
+    table->capacity = 0;
+    table->live = 0;
+    table->free_head = -1;
+}
+
+Py_ssize_t
+HandleTable_add(HandleTable* table, PyObject* obj, JSObject* jsobj)
+{
+    HandleEntry* entries = NULL;
+    Py_ssize_t capacity;
+    Py_ssize_t handle;
+    Py_ssize_t i;
+
+    if(table->free_head < 0)
+    {
+        capacity = table->capacity ? table->capacity * 2 : HANDLES_MIN_CAPACITY;
+        if(capacity > INT32_MAX)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Too many live Python objects.");
+            return -1;
+        }
+
+        entries = (HandleEntry*) realloc(table->entries, capacity * sizeof(HandleEntry));
+        if(entries == NULL)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        // Chain the new slots so the lowest one is handed out first.
+        for(i = table->capacity; i < capacity; i++)
+        {
+            entries[i].obj = NULL;
+            entries[i].next_free = (i + 1 < capacity) ? i + 1 : -1;
+        }
+
+        table->free_head = table->capacity;
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    handle = table->free_head;
+    table->free_head = table->entries[handle].next_free;
+
+    Py_INCREF(obj);
+    table->entries[handle].obj = obj;
+    table->entries[handle].jsobj = jsobj;
+    table->live++;
+
+    return handle;
+}
+
+void
+HandleTable_release(HandleTable* table, Py_ssize_t handle)
+{
+    PyObject* obj = table->entries[handle].obj;
+
+    table->entries[handle].obj = NULL;
+    table->entries[handle].next_free = table->free_head;
+    table->free_head = handle;
+    table->live--;
+
+    // Last, as this may run arbitrary Python code.
+    Py_DECREF(obj);
+}
+
+void
+HandleTable_free(HandleTable* table)
+{
+    free(table->entries);
+    HandleTable_init(table);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_HANDLES_H
+#define PYSM_HANDLES_H
+
+/*
+    The Python objects a Context has handed to JavaScript. Each
+    handle owns one reference and remembers the JSObject wrapping it.
+    Released slots are chained on a free list and reused first, so
+    the table only grows to the peak number of live wrappers.
+*/
+
+typedef struct {
+    PyObject* obj;          // NULL when the slot is free
+    union {
+        JSObject* jsobj;
+        Py_ssize_t next_free;
+    };
+} HandleEntry;
+
+typedef struct {
+    HandleEntry* entries;
+    Py_ssize_t capacity;
+    Py_ssize_t live;
+    Py_ssize_t free_head;   // -1 when empty
+} HandleTable;
+
+void HandleTable_init(HandleTable* table);
+// INCREFs obj. Returns the handle, or -1 with an exception set.
+Py_ssize_t HandleTable_add(HandleTable* table, PyObject* obj, JSObject* jsobj);
+void HandleTable_release(HandleTable* table, Py_ssize_t handle);
+// Frees the table without releasing the references it holds.
+void HandleTable_free(HandleTable* table);
+
+#define HandleTable_FOREACH(table, entry) \
+    for(entry = (table)->entries; entry < (table)->entries + (table)->capacity; entry++) \
+        if(entry->obj != NULL)
+
+#endif
@@ -83,6 +83,8 @@ HashCObj_dealloc(HashCObj* self)
 {
     if (self->finalizer != NULL)
 	(*self->finalizer)(self->cobj);
+
+    PyObject_Del(self);
 }
 
 PyTypeObject _HashCObjType = {
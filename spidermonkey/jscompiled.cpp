@@ -8,27 +8,33 @@
 
 #include "spidermonkey.h"
 
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 PyObject* 
 Compiled_Wrap(Context* cx, JSScript* sobj)
 {
     Compiled* self = NULL;
-    PyObject* tpl = NULL;
     PyObject* ret = NULL;
 
     JS_BeginRequest(cx->cx);
 
     // Build our new python object.
-    tpl = Py_BuildValue("(O)", cx);
-    if(tpl == NULL) goto error;
-    
-    self = (Compiled*) PyObject_CallObject((PyObject*) CompiledType, tpl);
+    self = (Compiled*) FreeList_Alloc(CompiledType);
     if(self == NULL) goto error;
+
+    Py_INCREF(cx);
+    self->cx = cx;
     
     // Attach the compiled blob
     self->sobj = sobj;
 
     if(!JS_AddNamedScriptRoot(cx->cx, &(self->sobj), "Compiled_Wrap"))
     {
+        self->sobj = NULL;
         PyErr_SetString(PyExc_RuntimeError, "Failed to set GC root.");
         goto error;
     }
@@ -40,7 +46,6 @@ error:
     Py_XDECREF(self);
     ret = NULL; // In case it was AddRoot
 success:
-    Py_XDECREF(tpl);
     JS_EndRequest(cx->cx);
     return (PyObject*) ret;
 }
@@ -83,6 +88,8 @@ void Compiled_dealloc(Compiled* self)
     }
    
     Py_XDECREF(self->cx);
+
+    FreeList_Release((PyObject*) self);
 }
 
 /* Note that the execution context does not have to be the same as the original
@@ -94,9 +101,15 @@ static PyObject* Compiled_execute(Compiled* self, PyObject *args, PyObject* kwar
     PyObject* ret = NULL;
     Context* exctx = NULL;
     JSContext *jcx;
+    JSBool ok;
     jsval rval;
+    long timeout_ms = 0;
+    int64_t saved_deadline;
 
-    if (!PyArg_ParseTuple(args, "|O!", ContextType, &exctx))
+    const char *keywords[] = {"context", "timeout_ms", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O!l", (char **)keywords,
+				     ContextType, &exctx, &timeout_ms))
 	return NULL;
 
     if (exctx == NULL)
@@ -111,7 +124,16 @@ static PyObject* Compiled_execute(Compiled* self, PyObject *args, PyObject* kwar
 
     JS_BeginRequest(jcx);
 
-    if (!JS_ExecuteScript(jcx, exctx->root, self->sobj, &rval))
+    if (!Context_push_deadline(exctx, timeout_ms, &saved_deadline))
+	goto done;
+
+    Py_BEGIN_ALLOW_THREADS
+    ok = JS_ExecuteScript(jcx, exctx->root, self->sobj, &rval);
+    Py_END_ALLOW_THREADS
+
+    Context_pop_deadline(exctx, saved_deadline);
+
+    if (!ok)
     {
         if(!PyErr_Occurred())
         {
@@ -131,6 +153,274 @@ done:
     return ret;
 }
 
+static PyObject* Compiled_dumps(Compiled* self, PyObject *args, PyObject* kwargs)
+{
+    if (!Context_thread_OK(self->cx))
+	return NULL;
+
+    JSAutoRequest request(self->cx->cx);
+
+    return Compiled_encode(self->cx, self->sobj);
+}
+
+/*
+    The engine trusts XDR input and reads past the end of a truncated
+    buffer, so serialized scripts start with a header that is checked
+    before anything reaches JS_DecodeScript. The build id ties them to
+    the exact library that produced them.
+*/
+
+#define XDR_MAGIC "PYSMXDR1"
+
+typedef struct {
+    char magic[8];
+    uint32_t build;
+    uint32_t length;
+    uint32_t checksum;
+    uint32_t reserved;
+} XDRHeader;
+
+static uint32_t
+fnv1a(uint32_t hash, const void* data, size_t len)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+	hash ^= bytes[i];
+	hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+    The implementation version doesn't change between builds of the
+    same release, so the identity of the loaded library file is mixed
+    in as well.
+*/
+uint32_t
+Compiled_build_id(void)
+{
+    static uint32_t id = 0;
+    const char* version = JS_GetImplementationVersion();
+    size_t ptrsize = sizeof(void*);
+    Dl_info info;
+    struct stat st;
+
+    if (id != 0)
+	return id;
+
+    id = fnv1a(2166136261u, version, strlen(version));
+    id = fnv1a(id, &ptrsize, sizeof(ptrsize));
+
+    if (dladdr((void*) JS_GetImplementationVersion, &info) && info.dli_fname != NULL) {
+	id = fnv1a(id, info.dli_fname, strlen(info.dli_fname));
+	if (stat(info.dli_fname, &st) == 0) {
+	    id = fnv1a(id, &st.st_size, sizeof(st.st_size));
+	    id = fnv1a(id, &st.st_mtime, sizeof(st.st_mtime));
+	    id = fnv1a(id, &st.st_ino, sizeof(st.st_ino));
+	}
+    }
+
+    if (id == 0)
+	id = 1;
+
+    return id;
+}
+
+PyObject*
+Compiled_encode(Context* cx, JSScript* sobj)
+{
+    PyObject* ret = NULL;
+    XDRHeader header;
+    void* data = NULL;
+    uint32_t len = 0;
+
+    data = JS_EncodeScript(cx->cx, sobj, &len);
+    if (data == NULL) {
+	if (!PyErr_Occurred())
+	    PyErr_SetString(JSError, "Failed to encode script.");
+	return NULL;
+    }
+
+    memcpy(header.magic, XDR_MAGIC, sizeof(header.magic));
+    header.build = Compiled_build_id();
+    header.length = len;
+    header.checksum = fnv1a(2166136261u, data, len);
+    header.reserved = 0;
+
+    ret = PyString_FromStringAndSize(NULL, sizeof(header) + len);
+    if (ret != NULL) {
+	memcpy(PyString_AS_STRING(ret), &header, sizeof(header));
+	memcpy(PyString_AS_STRING(ret) + sizeof(header), data, len);
+    }
+
+    JS_free(cx->cx, data);
+    return ret;
+}
+
+JSScript*
+Compiled_decode(Context* cx, const char* data, size_t len)
+{
+    JSScript* ret = NULL;
+    XDRHeader header;
+    const char* payload = data + sizeof(header);
+
+    if (len < sizeof(header)) {
+	PyErr_SetString(JSError, "Serialized script is too short.");
+	return NULL;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, XDR_MAGIC, sizeof(header.magic)) != 0) {
+	PyErr_SetString(JSError, "Not a serialized script.");
+	return NULL;
+    }
+
+    if (header.build != Compiled_build_id()) {
+	PyErr_SetString(JSError, "Serialized script is from a different engine build.");
+	return NULL;
+    }
+
+    if (header.length != len - sizeof(header)) {
+	PyErr_SetString(JSError, "Serialized script has the wrong length.");
+	return NULL;
+    }
+
+    if (header.checksum != fnv1a(2166136261u, payload, header.length)) {
+	PyErr_SetString(JSError, "Serialized script is corrupt.");
+	return NULL;
+    }
+
+    // The payload behind the header isn't necessarily aligned.
+    CPyAutoFreeCharPtr copy((char*) malloc(header.length));
+    if (copy.isNull()) {
+	PyErr_NoMemory();
+	return NULL;
+    }
+    memcpy(copy, payload, header.length);
+
+    ret = JS_DecodeScript(cx->cx, copy, header.length, NULL, NULL);
+    if (ret == NULL && !PyErr_Occurred())
+	PyErr_SetString(JSError, "Failed to decode script.");
+
+    return ret;
+}
+
+/*
+    Cache entries are named after a hash of everything that affects the
+    bytecode: the engine release and build, the pointer size, the file
+    name, the line number and the source itself.
+*/
+PyObject*
+Compiled_cache_path(Context* cx, PyObject* code, const char* fname, unsigned int lineno)
+{
+    PyObject* dir = cx->rt->cache_dir;
+
+    if (dir == NULL)
+	return NULL;
+
+    CPyAutoObject utf8(NULL);
+    if (PyUnicode_Check(code)) {
+	utf8 = PyUnicode_AsUTF8String(code);
+	if (utf8.isNull())
+	    return NULL;
+	code = utf8;
+    }
+
+    CPyAutoObject hashlib(PyImport_ImportModule("hashlib"));
+    if (hashlib.isNull())
+	return NULL;
+
+    CPyAutoObject hash(PyObject_CallMethod(hashlib, "sha1", NULL));
+    if (hash.isNull())
+	return NULL;
+
+    CPyAutoObject header(PyString_FromFormat("%s/%lu/%d/%s/%u\n",
+			JS_GetImplementationVersion(), (unsigned long) Compiled_build_id(),
+			(int) sizeof(void*), fname, lineno));
+    if (header.isNull())
+	return NULL;
+
+    CPyAutoObject tmp(PyObject_CallMethod(hash, "update", "O", (PyObject*) header));
+    if (tmp.isNull())
+	return NULL;
+
+    tmp = PyObject_CallMethod(hash, "update", "O", code);
+    if (tmp.isNull())
+	return NULL;
+
+    CPyAutoObject digest(PyObject_CallMethod(hash, "hexdigest", NULL));
+    if (digest.isNull())
+	return NULL;
+
+    return PyString_FromFormat("%s/%s.jsc", PyString_AsString(dir), PyString_AsString(digest));
+}
+
+JSScript*
+Compiled_cache_load(Context* cx, PyObject* path)
+{
+    JSScript* ret = NULL;
+    FILE* fp;
+    long len;
+
+    fp = fopen(PyString_AsString(path), "rb");
+    if (fp == NULL)
+	return NULL;
+
+    if (fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+	CPyAutoFreeCharPtr data((char*) malloc(len));
+	if (!data.isNull() && fread(data, 1, len, fp) == (size_t) len)
+	    ret = Compiled_decode(cx, data, len);
+    }
+
+    fclose(fp);
+
+    // A stale or corrupt entry just means we compile again, so drop
+    // whatever the error reporter raised for it.
+    if (ret == NULL) {
+	if (JS_IsExceptionPending(cx->cx))
+	    JS_ClearPendingException(cx->cx);
+	PyErr_Clear();
+    }
+
+    return ret;
+}
+
+void
+Compiled_cache_store(Context* cx, JSScript* sobj, PyObject* path)
+{
+    FILE* fp;
+    int ok;
+
+    CPyAutoObject data(Compiled_encode(cx, sobj));
+    if (data.isNull()) {
+	if (JS_IsExceptionPending(cx->cx))
+	    JS_ClearPendingException(cx->cx);
+	PyErr_Clear();
+	return;
+    }
+
+    // Write to a private file first so readers never see a partial entry.
+    CPyAutoObject tmppath(PyString_FromFormat("%s.%ld.tmp", PyString_AsString(path), (long) getpid()));
+    if (tmppath.isNull()) {
+	PyErr_Clear();
+	return;
+    }
+
+    fp = fopen(PyString_AsString(tmppath), "wb");
+    if (fp != NULL) {
+	ok = fwrite(PyString_AS_STRING((PyObject*) data), 1,
+		    PyString_GET_SIZE((PyObject*) data), fp)
+		== (size_t) PyString_GET_SIZE((PyObject*) data);
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || rename(PyString_AsString(tmppath), PyString_AsString(path)) != 0)
+	    unlink(PyString_AsString(tmppath));
+    }
+}
+
 static PyMemberDef Compiled_members[] = {
     {NULL}
 };
@@ -138,6 +428,8 @@ static PyMemberDef Compiled_members[] = {
 static PyMethodDef Compiled_methods[] = {
     {"execute", (PyCFunction) Compiled_execute, METH_KEYWORDS | METH_VARARGS,
      "Execute the compiled Javascript code"},
+    {"dumps", (PyCFunction) Compiled_dumps, METH_NOARGS,
+     "Serialize the compiled bytecode, see Context.loads()."},
     {NULL}
 };
 
@@ -29,4 +29,15 @@ extern PyTypeObject _CompiledType;
 
 PyObject* Compiled_Wrap(Context* cx, JSScript* obj);
 
+// Serialized scripts with a checked header, see Compiled.dumps().
+uint32_t Compiled_build_id(void);
+PyObject* Compiled_encode(Context* cx, JSScript* sobj);
+JSScript* Compiled_decode(Context* cx, const char* data, size_t len);
+
+// On-disk bytecode cache, see Runtime.cache_dir().
+PyObject* Compiled_cache_path(Context* cx, PyObject* code, const char* fname,
+                                unsigned int lineno);
+JSScript* Compiled_cache_load(Context* cx, PyObject* path);
+void Compiled_cache_store(Context* cx, JSScript* sobj, PyObject* path);
+
 #endif
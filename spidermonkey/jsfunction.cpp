@@ -21,18 +21,26 @@ js2py_function(Context* cx, jsval val, jsval parent)
     ret = (Function*) make_object(FunctionType, cx, val);
     if(ret == NULL) goto error;
 
-    ret->parent = parent;
-    if(!JS_AddNamedValueRoot(cx->cx, &(ret->parent), "js2py_function"))
+    // A cached wrapper is only reusable if it calls with the same this.
+    // Fresh wrappers have no object or null parent yet.
+    if(ret->parent.isObject() || ret->parent.isNull())
     {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to add GC root.");
-        goto error;
+        if(ret->parent.asRawBits() == parent.asRawBits()) goto success;
+
+        Py_DECREF((PyObject*) ret);
+        ret = (Function*) make_object_uncached(FunctionType, cx, val);
+        if(ret == NULL) goto error;
     }
 
+    ret->parent = parent;
+    ret->parent_root = RootArena_add(&(cx->roots), parent);
+    if(ret->parent_root == NULL) goto error;
+
     goto success;
 
 error:
     Py_XDECREF((PyObject*)ret);
-    ret = NULL; // In case of AddRoot error.
+    ret = NULL;
 success:
     return (PyObject*) ret;
 }
@@ -40,11 +48,9 @@ success:
 void
 Function_dealloc(Function* self)
 {
-    if(!JSVAL_IS_VOID(self->parent))
+    if(self->parent_root != NULL)
     {
-        JS_BeginRequest(self->obj.cx->cx);
-        JS_RemoveValueRoot(self->obj.cx->cx, &(self->parent));
-        JS_EndRequest(self->obj.cx->cx);
+        RootArena_release(&(self->obj.cx->roots), self->parent_root);
     }
 
     PJObjectType->tp_dealloc((PyObject*) self);
@@ -62,7 +68,48 @@ Function_call(Function* self, PyObject* args, PyObject* kwargs)
     jsval func;
     jsval* argv = NULL;
     jsval rval;
-    JSBool started_counter = JS_FALSE;
+    JSBool ok;
+    PyObject* pytimeout = NULL;
+    PyObject* pydeep = NULL;
+    long timeout_ms = 0;
+    long deep = 0;
+    jsval** roots = NULL;
+    int64_t saved_deadline;
+
+    if(!Context_thread_OK(self->obj.cx)) return NULL;
+
+    // timeout_ms and deep are the only keyword arguments, everything
+    // else is passed on to the JavaScript function.
+    if(kwargs != NULL && PyDict_Size(kwargs) > 0)
+    {
+        pytimeout = PyDict_GetItemString(kwargs, "timeout_ms");
+        pydeep = PyDict_GetItemString(kwargs, "deep");
+        if((pytimeout != NULL) + (pydeep != NULL) != PyDict_Size(kwargs))
+        {
+            PyErr_SetString(PyExc_TypeError,
+                "JavaScript functions only accept the timeout_ms and deep "
+                "keywords.");
+            return NULL;
+        }
+
+        if(pytimeout != NULL)
+        {
+            timeout_ms = PyInt_AsLong(pytimeout);
+            if(timeout_ms == -1 && PyErr_Occurred()) return NULL;
+        }
+
+        // deep=True copies containers with the default depth limit,
+        // a number sets the limit.
+        if(pydeep == Py_True)
+        {
+            deep = DEEPCONV_MAX_DEPTH;
+        }
+        else if(pydeep != NULL && pydeep != Py_False)
+        {
+            deep = PyInt_AsLong(pydeep);
+            if(deep == -1 && PyErr_Occurred()) return NULL;
+        }
+    }
 
     JS_BeginRequest(self->obj.cx->cx);
 
@@ -76,13 +123,35 @@ Function_call(Function* self, PyObject* args, PyObject* kwargs)
         goto error;
     }
     
+    // Copying containers allocates enough to trigger a GC between
+    // arguments, so the ones already converted are rooted.
+    if(deep > 0)
+    {
+        roots = (jsval**) calloc(argc, sizeof(jsval*));
+        if(roots == NULL)
+        {
+            PyErr_NoMemory();
+            goto error;
+        }
+    }
+
     for(idx = 0; idx < argc; idx++)
     {
         item = PySequence_GetItem(args, idx);
         if(item == NULL) goto error;
         
-        argv[idx] = py2js(self->obj.cx, item);
-        if(JSVAL_IS_VOID(argv[idx])) goto error;
+        if(deep > 0)
+        {
+            argv[idx] = py2js_deep(self->obj.cx, item, deep);
+            if(JSVAL_IS_VOID(argv[idx])) goto error;
+            roots[idx] = RootArena_add(&(self->obj.cx->roots), argv[idx]);
+            if(roots[idx] == NULL) goto error;
+        }
+        else
+        {
+            argv[idx] = py2js(self->obj.cx, item);
+            if(JSVAL_IS_VOID(argv[idx])) goto error;
+        }
         Py_DECREF(item);
         item = NULL; // Prevent double decref.
     }
@@ -91,14 +160,16 @@ Function_call(Function* self, PyObject* args, PyObject* kwargs)
     cx = self->obj.cx->cx;
     parent = JSVAL_TO_OBJECT(self->parent);
 
-    // Mark us for execution time if not already marked
-    if(self->obj.cx->start_time == 0)
-    {
-        started_counter = JS_TRUE;
-        self->obj.cx->start_time = time(NULL);
-    }
+    if(!Context_push_deadline(self->obj.cx, timeout_ms, &saved_deadline))
+        goto error;
+
+    Py_BEGIN_ALLOW_THREADS
+    ok = JS_CallFunctionValue(cx, parent, func, argc, argv, &rval);
+    Py_END_ALLOW_THREADS
 
-    if(!JS_CallFunctionValue(cx, parent, func, argc, argv, &rval))
+    Context_pop_deadline(self->obj.cx, saved_deadline);
+
+    if(!ok)
     {
         if(!PyErr_Occurred()) {
             PyErr_SetString(PyExc_RuntimeError, "JavaScript Function failed to execute");
@@ -107,21 +178,25 @@ Function_call(Function* self, PyObject* args, PyObject* kwargs)
     }
 
     ret = js2py(self->obj.cx, rval);
-    JS_EndRequest(self->obj.cx->cx);
-    JS_MaybeGC(cx);
+    if(ret == NULL) goto error;
     goto success;
 
 error:
-    if(argv != NULL) free(argv);
-    JS_EndRequest(self->obj.cx->cx);
+    Py_XDECREF(ret);
+    ret = NULL;
 success:
-
-    // Reset the time counter if we started it.
-    if(started_counter)
+    if(roots != NULL)
     {
-        self->obj.cx->start_time = 0;
+        for(idx = 0; idx < argc; idx++)
+        {
+            if(roots[idx] == NULL) continue;
+            RootArena_release(&(self->obj.cx->roots), roots[idx]);
+        }
+        free(roots);
     }
-
+    if(argv != NULL) free(argv);
+    JS_EndRequest(self->obj.cx->cx);
+    if(ret != NULL) JS_MaybeGC(self->obj.cx->cx);
     Py_XDECREF(item);
     return ret;
 }
@@ -17,6 +17,7 @@
 typedef struct {
     PJObject obj;
     jsval parent;
+    jsval* parent_root;
 } Function;
 
 extern PyTypeObject _FunctionType;
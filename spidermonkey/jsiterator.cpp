@@ -12,37 +12,31 @@ PyObject*
 Iterator_Wrap(Context* cx, JSObject* obj)
 {
     Iterator* self = NULL;
-    PyObject* tpl = NULL;
     PyObject* ret = NULL;
 
     JS_BeginRequest(cx->cx);
 
     // Build our new python object.
-    tpl = Py_BuildValue("(O)", cx);
-    if(tpl == NULL) goto error;
-    
-    self = (Iterator*) PyObject_CallObject((PyObject*) IteratorType, tpl);
+    self = (Iterator*) FreeList_Alloc(IteratorType);
     if(self == NULL) goto error;
+
+    Py_INCREF(cx);
+    self->cx = cx;
     
     // Attach a JS property iterator.
     self->iter = JS_NewPropertyIterator(cx->cx, obj);
     if(self->iter == NULL) goto error;
 
-    self->root = OBJECT_TO_JSVAL(self->iter);
-    if(!JS_AddNamedValueRoot(cx->cx, &(self->root), "Iterator_Wrap"))
-    {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to set GC root.");
-        goto error;
-    }
+    self->root = RootArena_add(&(cx->roots), OBJECT_TO_JSVAL(self->iter));
+    if(self->root == NULL) goto error;
 
     ret = (PyObject*) self;
     goto success;
 
 error:
     Py_XDECREF(self);
-    ret = NULL; // In case it was AddRoot
+    ret = NULL;
 success:
-    Py_XDECREF(tpl);
     JS_EndRequest(cx->cx);
     return (PyObject*) ret;
 }
@@ -61,6 +55,7 @@ Iterator_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     Py_INCREF(cx);
     self->cx = cx;
     self->iter = NULL;
+    self->root = NULL;
     goto success;
 
 error:
@@ -78,14 +73,14 @@ Iterator_init(Iterator* self, PyObject* args, PyObject* kwargs)
 void
 Iterator_dealloc(Iterator* self)
 {
-    if(self->iter != NULL)
+    if(self->root != NULL)
     {
-        JS_BeginRequest(self->cx->cx);
-        JS_RemoveValueRoot(self->cx->cx, &(self->root));
-        JS_EndRequest(self->cx->cx);
+        RootArena_release(&(self->cx->roots), self->root);
     }
    
     Py_XDECREF(self->cx);
+
+    FreeList_Release((PyObject*) self);
 }
 
 PyObject*
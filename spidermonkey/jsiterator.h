@@ -18,7 +18,7 @@ typedef struct {
     PyObject_HEAD
     Context* cx;
     JSObject* iter;
-    jsval root;
+    jsval* root;
 } Iterator;
 
 extern PyTypeObject _IteratorType;
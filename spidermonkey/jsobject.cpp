@@ -8,37 +8,68 @@
 
 #include "spidermonkey.h"
 
-PyObject* make_object(PyTypeObject* type, Context* cx, jsval val)
+PyObject* make_object_uncached(PyTypeObject* type, Context* cx, jsval val)
 {
     JSObject* obj = JSVAL_TO_OBJECT(val);
 
     JSAutoRequest request(cx->cx);
 
-    // Wrap JS value
-    CPyAutoObject tpl(Py_BuildValue("(O)", cx));
-    if (tpl == NULL)
-	return NULL;
-    
-    CPyAutoPJObject wrapped((PJObject*)PyObject_CallObject((PyObject*) type, tpl));
+    CPyAutoPJObject wrapped(PJObject_Alloc(type, cx));
     if (wrapped.isNull())
 	return NULL;
     
     wrapped->val = val;
     wrapped->obj = obj;
 
-    if (!JS_AddNamedValueRoot(cx->cx, &(wrapped->val), "make_object")) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to set GC root.");
+    wrapped->root = RootArena_add(&(cx->roots), val);
+    if (wrapped->root == NULL)
 	return NULL;
-    }
 
     return (PyObject*)wrapped.asNew();
 }
 
+PyObject* make_object(PyTypeObject* type, Context* cx, jsval val)
+{
+    JSObject* obj = JSVAL_TO_OBJECT(val);
+    PyObject* ret = (PyObject*) PtrMap_get(&(cx->wrappers), obj);
+
+    if (ret != NULL && Py_TYPE(ret) == type) {
+	Py_INCREF(ret);
+	return ret;
+    }
+
+    ret = make_object_uncached(type, cx, val);
+    if (ret == NULL)
+	return NULL;
+
+    // Leave an existing wrapper of another type in place.
+    if (PtrMap_get(&(cx->wrappers), obj) == NULL
+	&& !PtrMap_put(&(cx->wrappers), obj, ret)) {
+	Py_DECREF(ret);
+	return PyErr_NoMemory();
+    }
+
+    return ret;
+}
+
 PyObject* js2py_object(Context* cx, jsval val)
 {
     return make_object(PJObjectType, cx, val);
 }
 
+PJObject* PJObject_Alloc(PyTypeObject* type, Context* cx)
+{
+    PJObject* self = (PJObject*) FreeList_Alloc(type);
+    if (self == NULL)
+	return NULL;
+
+    Py_INCREF(cx);
+    self->cx = cx;
+    self->val = JSVAL_VOID;
+
+    return self;
+}
+
 PyObject* PJObject_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
 {
     PJObject* self = NULL;
@@ -59,6 +90,7 @@ PyObject* PJObject_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     self->cx = cx;
     self->val = JSVAL_VOID;
     self->obj = NULL;
+    self->root = NULL;
 
     return (PyObject*) self;
 }
@@ -70,19 +102,20 @@ int PJObject_init(PJObject* self, PyObject* args, PyObject* kwargs)
 
 void PJObject_dealloc(PJObject* self)
 {
-    if (!JSVAL_IS_VOID(self->val)) {
-	JSAutoRequest request(self->cx->cx);
-        JS_RemoveValueRoot(self->cx->cx, &(self->val));
-    }
+    if (self->obj != NULL && PtrMap_get(&(self->cx->wrappers), self->obj) == self)
+	PtrMap_remove(&(self->cx->wrappers), self->obj);
+
+    if (self->root != NULL)
+	RootArena_release(&(self->cx->roots), self->root);
    
     Py_XDECREF(self->cx);
+
+    FreeList_Release((PyObject*) self);
 }
 
 PyObject* PJObject_repr(PJObject* self)
 {
     JSString* repr = NULL;
-    const jschar* rchars = NULL;
-    size_t rlen;
     
     JSAutoRequest request(self->cx->cx);
 
@@ -92,10 +125,7 @@ PyObject* PJObject_repr(PJObject* self)
         return NULL;
     }
 
-    rchars = JS_GetStringCharsZ(self->cx->cx, repr);
-    rlen = JS_GetStringLength(repr);
-
-    return PyUnicode_Decode((const char*) rchars, rlen*2, "utf-16", "strict");
+    return js2py_string_obj(self->cx, repr);
 }
 
 Py_ssize_t PJObject_length(PJObject* self)
@@ -117,14 +147,8 @@ PyObject* PJObject_getitem(PJObject* self, PyObject* key)
 
     JSAutoRequest request(self->cx->cx);
 
-    pval = py2js(self->cx, key);
-    if (JSVAL_IS_VOID(pval)) 
+    if (!KeyCache_to_id(self->cx, key, &pid))
 	return NULL;
-   
-    if(!JS_ValueToId(self->cx->cx, pval, &pid)) {
-        PyErr_SetString(PyExc_KeyError, "Failed to get property id.");
-	return NULL;
-    }
     
     if(!JS_GetPropertyById(self->cx->cx, self->obj, pid, &pval)) {
         PyErr_SetString(PyExc_AttributeError, "Failed to get property.");
@@ -136,20 +160,13 @@ PyObject* PJObject_getitem(PJObject* self, PyObject* key)
 
 int PJObject_setitem(PJObject* self, PyObject* key, PyObject* val)
 {
-    jsval pval;
     jsval vval;
     jsid pid;
 
     JSAutoRequest request(self->cx->cx);
 
-    pval = py2js(self->cx, key);
-    if (JSVAL_IS_VOID(pval))
-	return -1;
-   
-    if (!JS_ValueToId(self->cx->cx, pval, &pid)) {
-        PyErr_SetString(PyExc_KeyError, "Failed to get property id.");
+    if (!KeyCache_to_id(self->cx, key, &pid))
 	return -1;
-    }
    
     if (val != NULL) {
         vval = py2js(self->cx, val);
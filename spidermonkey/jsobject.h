@@ -19,12 +19,17 @@ typedef struct {
     Context* cx;
     jsval val;
     JSObject* obj;
+    jsval* root;    // Slot in cx->roots keeping val alive.
 } PJObject;
 
 extern PyTypeObject _PJObjectType;
 
+// Returns the Context's existing wrapper for the object if it has one.
 PyObject* make_object(PyTypeObject* type, Context* cx, jsval val);
+PyObject* make_object_uncached(PyTypeObject* type, Context* cx, jsval val);
 PyObject* js2py_object(Context* cx, jsval val);
+// Internal constructor for PJObject and its subtypes.
+PJObject* PJObject_Alloc(PyTypeObject* type, Context* cx);
 
 typedef CPyAuto<PJObject> CPyAutoPJObject;
 
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+static size_t
+slot_of(const void* ptr)
+{
+    uintptr_t h = (uintptr_t) ptr;
+
+    // Allocations are aligned, so mix the high bits down.
+    h ^= h >> 9;
+    h *= (uintptr_t) 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 7) & (KEYCACHE_SLOTS - 1);
+}
+
+static void
+set_entry(KeyCacheEntry* entry, PyObject* key, jsid id)
+{
+    PyObject* old = entry->key;
+
+    Py_INCREF(key);
+    entry->key = key;
+    entry->id = id;
+    entry->atom = STRING_TO_JSVAL(JSID_TO_STRING(id));
+    Py_XDECREF(old);
+}
+
+/*
+    Atoms are only kept alive through the tracer, which an incremental
+    GC has already run by the time a new entry shows up.
+*/
+static int
+cacheable(Context* cx, PyObject* key)
+{
+    return PyString_CheckExact(key) && PyString_CHECK_INTERNED(key)
+            && !JS::IsIncrementalGCInProgress(cx->rt->rt);
+}
+
+void
+KeyCache_init(KeyCache* cache)
+{
+    cache->to_id = NULL;
+    cache->to_py = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+void
+KeyCache_free(KeyCache* cache)
+{
+    int i;
+
+    for(i = 0; cache->to_id != NULL && i < KEYCACHE_SLOTS; i++)
+    {
+        Py_XDECREF(cache->to_id[i].key);
+        Py_XDECREF(cache->to_py[i].key);
+    }
+
+    free(cache->to_id);
+    free(cache->to_py);
+    KeyCache_init(cache);
+}
+
+void
+KeyCache_trace(KeyCache* cache, JSTracer* trc)
+{
+    int i;
+
+    for(i = 0; cache->to_id != NULL && i < KEYCACHE_SLOTS; i++)
+    {
+        if(cache->to_id[i].key != NULL)
+        {
+            JS_CallValueTracer(trc, &(cache->to_id[i].atom), "KeyCache");
+        }
+        if(cache->to_py[i].key != NULL)
+        {
+            JS_CallValueTracer(trc, &(cache->to_py[i].atom), "KeyCache");
+        }
+    }
+}
+
+static int
+allocate(KeyCache* cache)
+{
+    if(cache->to_id != NULL) return 1;
+
+    cache->to_id = (KeyCacheEntry*) calloc(KEYCACHE_SLOTS, sizeof(KeyCacheEntry));
+    cache->to_py = (KeyCacheEntry*) calloc(KEYCACHE_SLOTS, sizeof(KeyCacheEntry));
+    if(cache->to_id == NULL || cache->to_py == NULL)
+    {
+        free(cache->to_id);
+        free(cache->to_py);
+        cache->to_id = NULL;
+        cache->to_py = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+int
+KeyCache_to_id(Context* cx, PyObject* key, jsid* id)
+{
+    KeyCache* cache = &(cx->keys);
+    KeyCacheEntry* entry = NULL;
+    jsval val;
+
+    if(cache->to_id != NULL)
+    {
+        entry = &(cache->to_id[slot_of(key)]);
+        if(entry->key == key)
+        {
+            cache->hits++;
+            *id = entry->id;
+            return 1;
+        }
+    }
+
+    cache->misses++;
+
+    val = py2js(cx, key);
+    if(JSVAL_IS_VOID(val)) return 0;
+
+    if(!JS_ValueToId(cx->cx, val, id))
+    {
+        PyErr_SetString(PyExc_KeyError, "Failed to get property id.");
+        return 0;
+    }
+
+    // Index-like strings become int ids, which need no atom.
+    if(cacheable(cx, key) && JSID_IS_STRING(*id) && allocate(cache))
+    {
+        set_entry(&(cache->to_id[slot_of(key)]), key, *id);
+    }
+
+    return 1;
+}
+
+PyObject*
+KeyCache_to_py(Context* cx, jsid id)
+{
+    KeyCache* cache = &(cx->keys);
+    KeyCacheEntry* entry = NULL;
+
+    if(!JSID_IS_STRING(id) || cache->to_py == NULL) return NULL;
+
+    entry = &(cache->to_py[slot_of(JSID_TO_STRING(id))]);
+    if(entry->key == NULL || JSID_BITS(entry->id) != JSID_BITS(id)) return NULL;
+
+    cache->hits++;
+    Py_INCREF(entry->key);
+    return entry->key;
+}
+
+void
+KeyCache_remember(Context* cx, PyObject* key, jsid id)
+{
+    KeyCache* cache = &(cx->keys);
+
+    cache->misses++;
+    if(!cacheable(cx, key) || !JSID_IS_STRING(id) || !allocate(cache)) return;
+
+    set_entry(&(cache->to_py[slot_of(JSID_TO_STRING(id))]), key, id);
+}
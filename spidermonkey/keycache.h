@@ -0,0 +1,47 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_KEYCACHE_H
+#define PYSM_KEYCACHE_H
+
+/*
+    Two direct mapped caches between interned Python strings and the
+    atoms JavaScript names properties with, one per direction. A new
+    key simply replaces whatever shared its slot. Entries hold a
+    reference to the string and the atom is traced by the runtime, so
+    both sides stay valid for as long as they are cached.
+*/
+
+#define KEYCACHE_SLOTS 256
+
+typedef struct {
+    PyObject* key;      // Interned str, or NULL when empty
+    jsid id;
+    jsval atom;         // The same atom as id, for the tracer
+} KeyCacheEntry;
+
+typedef struct {
+    KeyCacheEntry* to_id;       // Indexed by the str's address
+    KeyCacheEntry* to_py;       // Indexed by the atom's address
+    Py_ssize_t hits;
+    Py_ssize_t misses;
+} KeyCache;
+
+struct Context;
+
+void KeyCache_init(KeyCache* cache);
+void KeyCache_free(KeyCache* cache);
+void KeyCache_trace(KeyCache* cache, JSTracer* trc);
+
+// Returns 0 with an exception set on failure.
+int KeyCache_to_id(struct Context* cx, PyObject* key, jsid* id);
+// Returns a new reference, or NULL if the id isn't cached.
+PyObject* KeyCache_to_py(struct Context* cx, jsid id);
+void KeyCache_remember(struct Context* cx, PyObject* key, jsid id);
+
+#endif
@@ -0,0 +1,607 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+#include <unistd.h>
+
+#define POOL_MAX_DEPTH 64
+
+static void
+PoolJob_free(PoolJob* job)
+{
+    Py_XDECREF(job->code);
+    Py_XDECREF(job->args);
+    Py_XDECREF(job->filename);
+    Py_XDECREF((PyObject*) job->future);
+    free(job);
+}
+
+/*
+    JavaScript objects are bound to the worker's runtime and must
+    never leave its thread, so results are copied into plain
+    Python containers before they are handed to the Future.
+*/
+static PyObject*
+Pool_detach(PyObject* val, int depth)
+{
+    PyObject* ret = NULL;
+    PyObject* iter = NULL;
+    PyObject* key = NULL;
+    PyObject* item = NULL;
+    PyObject* conv = NULL;
+    Py_ssize_t len;
+    Py_ssize_t idx;
+
+    if(depth > POOL_MAX_DEPTH)
+    {
+        PyErr_SetString(PyExc_ValueError, "Result nested too deeply.");
+        return NULL;
+    }
+
+    if(PyObject_TypeCheck(val, FunctionType))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                            "JavaScript functions cannot leave a Pool worker.");
+        return NULL;
+    }
+    else if(PyObject_TypeCheck(val, ArrayType))
+    {
+        len = PySequence_Length(val);
+        if(len < 0) return NULL;
+
+        ret = PyList_New(len);
+        if(ret == NULL) return NULL;
+
+        for(idx = 0; idx < len; idx++)
+        {
+            item = PySequence_GetItem(val, idx);
+            if(item == NULL) goto error;
+
+            conv = Pool_detach(item, depth+1);
+            Py_CLEAR(item);
+            if(conv == NULL) goto error;
+
+            PyList_SET_ITEM(ret, idx, conv);
+        }
+
+        return ret;
+    }
+    else if(PyObject_TypeCheck(val, PJObjectType))
+    {
+        ret = PyDict_New();
+        if(ret == NULL) return NULL;
+
+        iter = PyObject_GetIter(val);
+        if(iter == NULL) goto error;
+
+        while((key = PyIter_Next(iter)) != NULL)
+        {
+            item = PyObject_GetItem(val, key);
+            if(item == NULL) goto error;
+
+            conv = Pool_detach(item, depth+1);
+            Py_CLEAR(item);
+            if(conv == NULL) goto error;
+
+            if(PyDict_SetItem(ret, key, conv) < 0) goto error;
+            Py_CLEAR(conv);
+            Py_CLEAR(key);
+        }
+
+        if(PyErr_Occurred()) goto error;
+
+        Py_DECREF(iter);
+        return ret;
+    }
+
+    Py_INCREF(val);
+    return val;
+
+error:
+    Py_XDECREF(ret);
+    Py_XDECREF(iter);
+    Py_XDECREF(key);
+    Py_XDECREF(item);
+    Py_XDECREF(conv);
+    return NULL;
+}
+
+/*
+    Runs on the worker thread with the GIL held. Sources are compiled
+    once per Context and kept in that Context's script cache.
+*/
+static PyObject*
+Pool_run(PoolJob* job, PyObject* cx, PyObject* scripts)
+{
+    PyObject* key = NULL;
+    PyObject* compiled = NULL;
+    PyObject* res = NULL;
+    PyObject* called = NULL;
+    PyObject* ret = NULL;
+
+    key = Py_BuildValue("(OOI)", job->code, job->filename, job->lineno);
+    if(key == NULL) goto done;
+
+    compiled = PyDict_GetItem(scripts, key);
+    if(compiled != NULL)
+    {
+        Py_INCREF(compiled);
+    }
+    else
+    {
+        compiled = PyObject_CallMethod(cx, "compile", "OOI",
+                            job->code, job->filename, job->lineno);
+        if(compiled == NULL) goto done;
+        if(PyDict_SetItem(scripts, key, compiled) < 0) goto done;
+    }
+
+    res = PyObject_CallMethod(compiled, "execute", NULL);
+    if(res == NULL) goto done;
+
+    if(job->args != Py_None)
+    {
+        if(!PyCallable_Check(res))
+        {
+            PyErr_SetString(PyExc_TypeError,
+                        "Script submitted with arguments must return a function.");
+            goto done;
+        }
+
+        called = PyObject_CallObject(res, job->args);
+        Py_DECREF(res);
+        res = called;
+        if(res == NULL) goto done;
+    }
+
+    ret = Pool_detach(res, 0);
+
+done:
+    Py_XDECREF(key);
+    Py_XDECREF(compiled);
+    Py_XDECREF(res);
+    return ret;
+}
+
+static void*
+Pool_worker(void* arg)
+{
+    Pool* self = (Pool*) arg;
+    PyGILState_STATE gstate;
+    PyThreadState* tstate;
+    PyObject* rt = NULL;
+    PyObject* contexts = NULL;
+    PyObject* scripts = NULL;
+    PyObject* cx = NULL;
+    PyObject* res = NULL;
+    PoolJob* job = NULL;
+    unsigned int next = 0;
+    int idx;
+
+    gstate = PyGILState_Ensure();
+
+    // Every Runtime is bound to the thread that created it.
+    rt = PyObject_CallFunction((PyObject*) RuntimeType, "I", self->stacksize);
+    if(rt == NULL) goto init_error;
+
+    contexts = PyList_New(self->ncontexts);
+    if(contexts == NULL) goto init_error;
+
+    scripts = PyList_New(self->ncontexts);
+    if(scripts == NULL) goto init_error;
+
+    for(idx = 0; idx < self->ncontexts; idx++)
+    {
+        cx = PyObject_CallMethod(rt, "new_context", "OO",
+                                    self->global, self->access);
+        if(cx == NULL) goto init_error;
+        PyList_SET_ITEM(contexts, idx, cx);
+
+        cx = PyDict_New();
+        if(cx == NULL) goto init_error;
+        PyList_SET_ITEM(scripts, idx, cx);
+    }
+
+    goto init_done;
+
+init_error:
+    pthread_mutex_lock(&self->lock);
+    if(self->init_type == NULL)
+    {
+        PyErr_Fetch(&self->init_type, &self->init_value, &self->init_tb);
+    }
+    PyErr_Clear();
+    Py_CLEAR(contexts);
+    self->closing = 1;
+    pthread_mutex_unlock(&self->lock);
+
+init_done:
+    pthread_mutex_lock(&self->lock);
+    self->ready++;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    tstate = PyEval_SaveThread();
+
+    for(;;)
+    {
+        pthread_mutex_lock(&self->lock);
+        while(self->head == NULL && !self->closing)
+        {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+        job = self->head;
+        if(job != NULL)
+        {
+            self->head = job->next;
+            if(self->head == NULL) self->tail = NULL;
+        }
+        pthread_mutex_unlock(&self->lock);
+
+        if(job == NULL) break;
+
+        PyEval_RestoreThread(tstate);
+
+        if(contexts == NULL)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Pool worker failed to start.");
+            Future_set_exception(job->future);
+        }
+        else
+        {
+            idx = next++ % self->ncontexts;
+            res = Pool_run(job, PyList_GET_ITEM(contexts, idx),
+                                PyList_GET_ITEM(scripts, idx));
+            if(res == NULL)
+            {
+                Future_set_exception(job->future);
+            }
+            else
+            {
+                Future_set_result(job->future, res);
+                Py_DECREF(res);
+            }
+        }
+
+        PoolJob_free(job);
+        tstate = PyEval_SaveThread();
+    }
+
+    PyEval_RestoreThread(tstate);
+
+    // Contexts must go before their Runtime, and both on this thread.
+    Py_XDECREF(scripts);
+    Py_XDECREF(contexts);
+    Py_XDECREF(rt);
+
+    PyGILState_Release(gstate);
+    return NULL;
+}
+
+static void
+Pool_shutdown(Pool* self)
+{
+    int idx;
+
+    if(self->threads == NULL) return;
+
+    pthread_mutex_lock(&self->lock);
+    self->closing = 1;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    Py_BEGIN_ALLOW_THREADS
+    for(idx = 0; idx < self->nthreads; idx++)
+    {
+        pthread_join(self->threads[idx], NULL);
+    }
+    Py_END_ALLOW_THREADS
+
+    free(self->threads);
+    self->threads = NULL;
+}
+
+PyObject*
+Pool_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    Pool* self = NULL;
+    PyObject* global = Py_None;
+    PyObject* access = Py_None;
+    int workers = 0;
+    int contexts = 1;
+    unsigned int stacksize = 0x2000000;
+    int started = 0;
+
+    const char* keywords[] = {"workers", "contexts", "glbl", "access",
+                                    "stacksize", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(
+        args, kwargs,
+        "|iiOOI",
+        (char **)keywords,
+        &workers,
+        &contexts,
+        &global,
+        &access,
+        &stacksize
+    )) return NULL;
+
+    if(workers <= 0) workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(workers <= 0) workers = 1;
+
+    if(contexts <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Pool needs at least one context.");
+        return NULL;
+    }
+
+    self = (Pool*) type->tp_alloc(type, 0);
+    if(self == NULL) return NULL;
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    self->ncontexts = contexts;
+    self->stacksize = stacksize;
+
+    Py_INCREF(global);
+    self->global = global;
+    Py_INCREF(access);
+    self->access = access;
+
+    self->threads = (pthread_t*) calloc(workers, sizeof(pthread_t));
+    if(self->threads == NULL)
+    {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    for(started = 0; started < workers; started++)
+    {
+        if(pthread_create(&self->threads[started], NULL, Pool_worker, self) != 0)
+            break;
+    }
+    self->nthreads = started;
+
+    // Wait for the workers to build their runtimes.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->lock);
+    while(self->ready < self->nthreads)
+    {
+        pthread_cond_wait(&self->cond, &self->lock);
+    }
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+
+    if(self->init_type != NULL)
+    {
+        Pool_shutdown(self);
+        PyErr_Restore(self->init_type, self->init_value, self->init_tb);
+        self->init_type = self->init_value = self->init_tb = NULL;
+        goto error;
+    }
+
+    if(started < workers)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to start Pool worker.");
+        goto error;
+    }
+
+    return (PyObject*) self;
+
+error:
+    Py_XDECREF(self);
+    return NULL;
+}
+
+void
+Pool_dealloc(Pool* self)
+{
+    PoolJob* job;
+
+    Pool_shutdown(self);
+
+    // Only possible if no worker could be started.
+    while(self->head != NULL)
+    {
+        job = self->head;
+        self->head = job->next;
+        PyErr_SetString(PyExc_RuntimeError, "Pool was destroyed.");
+        Future_set_exception(job->future);
+        PoolJob_free(job);
+    }
+
+    Py_XDECREF(self->global);
+    Py_XDECREF(self->access);
+    Py_XDECREF(self->init_type);
+    Py_XDECREF(self->init_value);
+    Py_XDECREF(self->init_tb);
+
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+
+    self->ob_type->tp_free((PyObject*) self);
+}
+
+PyObject*
+Pool_submit(Pool* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* code = NULL;
+    PyObject* fargs = Py_None;
+    PyObject* filename = NULL;
+    unsigned int lineno = 1;
+    PoolJob* job = NULL;
+    int closing;
+
+    const char* keywords[] = {"code", "args", "filename", "lineno", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(
+        args, kwargs,
+        "O|OSI",
+        (char **)keywords,
+        &code,
+        &fargs,
+        &filename,
+        &lineno
+    )) return NULL;
+
+    if(!PyString_Check(code) && !PyUnicode_Check(code))
+    {
+        PyErr_SetString(PyExc_TypeError, "Script source must be a string.");
+        return NULL;
+    }
+
+    if(fargs != Py_None && !PyTuple_Check(fargs))
+    {
+        PyErr_SetString(PyExc_TypeError, "Arguments must be a tuple.");
+        return NULL;
+    }
+
+    job = (PoolJob*) calloc(1, sizeof(PoolJob));
+    if(job == NULL) return PyErr_NoMemory();
+
+    job->future = Future_New();
+    if(job->future == NULL) goto error;
+
+    if(filename == NULL)
+    {
+        filename = PyString_FromString("<pool JavaScript>");
+        if(filename == NULL) goto error;
+    }
+    else
+    {
+        Py_INCREF(filename);
+    }
+
+    Py_INCREF(code);
+    Py_INCREF(fargs);
+    job->code = code;
+    job->args = fargs;
+    job->filename = filename;
+    job->lineno = lineno;
+
+    // The queue keeps its own reference to the future.
+    Py_INCREF((PyObject*) job->future);
+
+    pthread_mutex_lock(&self->lock);
+    closing = self->closing;
+    if(!closing)
+    {
+        if(self->tail != NULL) self->tail->next = job;
+        else self->head = job;
+        self->tail = job;
+        pthread_cond_signal(&self->cond);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    if(closing)
+    {
+        Py_DECREF((PyObject*) job->future);
+        PyErr_SetString(PyExc_RuntimeError, "Pool is closed.");
+        goto error;
+    }
+
+    return (PyObject*) job->future;
+
+error:
+    PoolJob_free(job);
+    return NULL;
+}
+
+PyObject*
+Pool_close(Pool* self, PyObject* args, PyObject* kwargs)
+{
+    pthread_mutex_lock(&self->lock);
+    self->closing = 1;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    Py_RETURN_NONE;
+}
+
+PyObject*
+Pool_join(Pool* self, PyObject* args, PyObject* kwargs)
+{
+    Pool_shutdown(self);
+    Py_RETURN_NONE;
+}
+
+PyObject*
+Pool_get_workers(Pool* self, void* closure)
+{
+    return PyInt_FromLong(self->nthreads);
+}
+
+static PyGetSetDef Pool_getset[] = {
+    {"workers", (getter)Pool_get_workers, NULL, "Number of worker threads.", NULL},
+    {NULL}
+};
+
+static PyMethodDef Pool_methods[] = {
+    {
+        "submit",
+        (PyCFunction)Pool_submit,
+        METH_VARARGS | METH_KEYWORDS,
+        "Run a script on a worker. With args, the script must evaluate to a "
+        "function which is then called. Returns a Future."
+    },
+    {
+        "close",
+        (PyCFunction)Pool_close,
+        METH_NOARGS,
+        "Stop accepting jobs. Queued jobs still run."
+    },
+    {
+        "join",
+        (PyCFunction)Pool_join,
+        METH_NOARGS,
+        "Close the pool and wait for the workers to exit."
+    },
+    {NULL}
+};
+
+PyTypeObject _PoolType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "spidermonkey.Pool",                        /*tp_name*/
+    sizeof(Pool),                               /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)Pool_dealloc,                   /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash*/
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    "Pool of JavaScript worker threads",        /*tp_doc*/
+    0,		                                    /*tp_traverse*/
+    0,		                                    /*tp_clear*/
+    0,		                                    /*tp_richcompare*/
+    0,		                                    /*tp_weaklistoffset*/
+    0,		                                    /*tp_iter*/
+    0,		                                    /*tp_iternext*/
+    Pool_methods,                               /*tp_methods*/
+    0,                                          /*tp_members*/
+    Pool_getset,                                /*tp_getset*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    0,                                          /*tp_init*/
+    0,                                          /*tp_alloc*/
+    Pool_new,                                   /*tp_new*/
+};
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_POOL_H
+#define PYSM_POOL_H
+
+/*
+    A set of worker threads, each owning its own Runtime and
+    Contexts. Scripts are submitted from any thread and their
+    results are returned through Futures.
+*/
+
+#include <Python.h>
+#include "structmember.h"
+
+#include <pthread.h>
+
+#include "future.h"
+
+typedef struct PoolJob {
+    struct PoolJob* next;
+    PyObject* code;
+    PyObject* args;
+    PyObject* filename;
+    unsigned int lineno;
+    Future* future;
+} PoolJob;
+
+typedef struct {
+    PyObject_HEAD
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    PoolJob* head;
+    PoolJob* tail;
+    pthread_t* threads;
+    int nthreads;
+    int ready;
+    int closing;
+    int ncontexts;
+    unsigned int stacksize;
+    PyObject* global;
+    PyObject* access;
+    PyObject* init_type;
+    PyObject* init_value;
+    PyObject* init_tb;
+} Pool;
+
+extern PyTypeObject _PoolType;
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ptrmap.h"
+
+#define PTRMAP_MIN_CAPACITY 16
+
+static size_t
+ptr_hash(const void* key)
+{
+    uintptr_t h = (uintptr_t) key;
+
+    // Allocations are aligned, so mix the high bits down.
+    h ^= h >> 17;
+    h *= (uintptr_t) 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    return (size_t) h;
+}
+
+static PtrMapEntry*
+find(PtrMap* map, const void* key)
+{
+    size_t mask = map->capacity - 1;
+    size_t i = ptr_hash(key) & mask;
+
+    while(map->entries[i].key != NULL)
+    {
+        if(map->entries[i].key == key) return &(map->entries[i]);
+        i = (i + 1) & mask;
+    }
+
+    return NULL;
+}
+
+static int
+resize(PtrMap* map, size_t capacity)
+{
+    PtrMapEntry* old = map->entries;
+    size_t oldcap = map->capacity;
+    size_t mask = capacity - 1;
+    size_t i;
+    size_t j;
+
+    map->entries = (PtrMapEntry*) calloc(capacity, sizeof(PtrMapEntry));
+    if(map->entries == NULL)
+    {
+        map->entries = old;
+        return 0;
+    }
+    map->capacity = capacity;
+    map->used = map->count;
+
+    for(i = 0; i < oldcap; i++)
+    {
+        if(old[i].key == NULL || old[i].key == PTRMAP_TOMBSTONE) continue;
+
+        j = ptr_hash(old[i].key) & mask;
+        while(map->entries[j].key != NULL) j = (j + 1) & mask;
+        map->entries[j] = old[i];
+    }
+
+    free(old);
+    return 1;
+}
+
+void
+PtrMap_init(PtrMap* map)
+{
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->used = 0;
+}
+
+void
+PtrMap_free(PtrMap* map)
+{
+    free(map->entries);
+    PtrMap_init(map);
+}
+
+void
+PtrMap_clear(PtrMap* map)
+{
+    if(map->used == 0) return;
+    memset(map->entries, 0, map->capacity * sizeof(PtrMapEntry));
+    map->count = 0;
+    map->used = 0;
+}
+
+void*
+PtrMap_get(PtrMap* map, const void* key)
+{
+    PtrMapEntry* entry;
+
+    if(map->count == 0) return NULL;
+
+    entry = find(map, key);
+    return entry == NULL ? NULL : entry->value;
+}
+
+int
+PtrMap_put(PtrMap* map, const void* key, void* value)
+{
+    PtrMapEntry* entry;
+    PtrMapEntry* slot = NULL;
+    size_t mask;
+    size_t i;
+
+    if(map->capacity > 0 && (entry = find(map, key)) != NULL)
+    {
+        entry->value = value;
+        return 1;
+    }
+
+    // Keep the load, tombstones included, under three quarters.
+    if((map->used + 1) * 4 > map->capacity * 3)
+    {
+        size_t capacity = map->capacity ? map->capacity : PTRMAP_MIN_CAPACITY;
+        if((map->count + 1) * 2 > capacity) capacity *= 2;
+        if(!resize(map, capacity)) return 0;
+    }
+
+    mask = map->capacity - 1;
+    i = ptr_hash(key) & mask;
+    while(map->entries[i].key != NULL && map->entries[i].key != PTRMAP_TOMBSTONE)
+    {
+        i = (i + 1) & mask;
+    }
+    slot = &(map->entries[i]);
+
+    if(slot->key == NULL) map->used++;
+    slot->key = key;
+    slot->value = value;
+    map->count++;
+    return 1;
+}
+
+void*
+PtrMap_remove(PtrMap* map, const void* key)
+{
+    PtrMapEntry* entry;
+    void* ret;
+
+    if(map->count == 0) return NULL;
+
+    entry = find(map, key);
+    if(entry == NULL) return NULL;
+
+    ret = entry->value;
+    entry->key = PTRMAP_TOMBSTONE;
+    entry->value = NULL;
+    map->count--;
+    return ret;
+}
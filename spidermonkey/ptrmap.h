@@ -0,0 +1,49 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_PTRMAP_H
+#define PYSM_PTRMAP_H
+
+#include <stddef.h>
+
+/*
+    An open addressing hash map from pointers to pointers. Neither
+    keys nor values are owned, and NULL is never a valid key. It is
+    only safe for pointers that don't move, which holds for GC things
+    as long as mozjs runs without a generational GC.
+*/
+
+typedef struct {
+    const void* key;
+    void* value;
+} PtrMapEntry;
+
+typedef struct {
+    PtrMapEntry* entries;
+    size_t capacity;    // Always zero or a power of two.
+    size_t count;
+    size_t used;        // Live entries plus tombstones.
+} PtrMap;
+
+void PtrMap_init(PtrMap* map);
+void PtrMap_free(PtrMap* map);
+// Removes every entry but keeps the table.
+void PtrMap_clear(PtrMap* map);
+void* PtrMap_get(PtrMap* map, const void* key);
+// Returns 0 when out of memory.
+int PtrMap_put(PtrMap* map, const void* key, void* value);
+// Returns the removed value, or NULL.
+void* PtrMap_remove(PtrMap* map, const void* key);
+
+#define PtrMap_FOREACH(map, entry) \
+    for(entry = (map)->entries; entry < (map)->entries + (map)->capacity; entry++) \
+        if(entry->key != NULL && entry->key != PTRMAP_TOMBSTONE)
+
+#define PTRMAP_TOMBSTONE ((const void*) 1)
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+// The names js_get_prop turns into iterators.
+static int
+is_iterator_key(PyObject* key)
+{
+    const char* name;
+
+    if(!PyString_Check(key)) return 0;
+    name = PyString_AS_STRING(key);
+    return strcmp(name, "iterator") == 0 || strcmp(name, "__iterator__") == 0;
+}
+
+static int
+is_length_id(JSContext* jscx, jsid id)
+{
+    JSBool match = JS_FALSE;
+
+    if(!JSID_IS_STRING(id)) return 0;
+    return JS_StringEqualsAscii(jscx, JSID_TO_STRING(id), "length", &match) && match;
+}
+
+JSBool
+js_dict_get(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                JS::MutableHandleValue rval)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyObject* pyobj = NULL;
+    PyObject* pyval = NULL;
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    pyobj = get_py_obj(jsobj);
+    if(pyobj == NULL) return JS_FALSE;
+
+    CPyAutoObject pykey(js2py_key(pycx, keyid));
+    if(pykey.isNull()) return JS_FALSE;
+
+    if(is_iterator_key(pykey)) return js_get_prop(jscx, jsobj, keyid, rval);
+
+    if(Context_has_access(pycx, jscx, pyobj, pykey) <= 0) return JS_FALSE;
+
+    // Borrowed, and a missing key raises nothing.
+    pyval = PyDict_GetItem(pyobj, pykey);
+    if(pyval != NULL)
+    {
+        // Converting can run Python code that drops the dict's reference.
+        Py_INCREF(pyval);
+        CPyAutoObject held(pyval);
+        rval.set(py2js(pycx, held));
+        return !rval.isUndefined();
+    }
+
+    // Methods like keys() are still reachable as attributes.
+    rval.setUndefined();
+    if(!PyString_Check(pykey) && !PyUnicode_Check(pykey)) return JS_TRUE;
+
+    CPyAutoObject attr(PyObject_GetAttr(pyobj, pykey));
+    if(attr.isNull())
+    {
+        PyErr_Clear();
+        return JS_TRUE;
+    }
+
+    rval.set(py2js(pycx, attr));
+    return !rval.isUndefined();
+}
+
+JSBool
+js_dict_set(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                JSBool strict, JS::MutableHandleValue rval)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyObject* pyobj = NULL;
+    jsval key;
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    pyobj = get_py_obj(jsobj);
+    if(pyobj == NULL) return JS_FALSE;
+
+    // Keys are stored as js2py makes them, as js_set_prop always did.
+    JS_IdToValue(jscx, keyid, &key);
+    CPyAutoObject pykey(js2py(pycx, key));
+    if(pykey.isNull()) return JS_FALSE;
+
+    if(Context_has_access(pycx, jscx, pyobj, pykey) <= 0) return JS_FALSE;
+
+    CPyAutoObject pyval(js2py(pycx, rval));
+    if(pyval.isNull()) return JS_FALSE;
+
+    if(PyDict_SetItem(pyobj, pykey, pyval) < 0)
+    {
+        JS_ReportError(jscx, "Failed to set dict item.");
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+/*
+    Index reads come straight out of the item array. Anything else,
+    including out of range indexes, takes the generic path.
+*/
+JSBool
+js_seq_get(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                JS::MutableHandleValue rval)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyObject* pyobj = NULL;
+    PyObject* item = NULL;
+    Py_ssize_t size;
+    int32_t idx;
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    pyobj = get_py_obj(jsobj);
+    if(pyobj == NULL) return JS_FALSE;
+
+    size = Py_SIZE(pyobj);
+
+    if(JSID_IS_INT(keyid))
+    {
+        idx = JSID_TO_INT(keyid);
+        if(idx < 0 || idx >= size) return js_get_prop(jscx, jsobj, keyid, rval);
+
+        if(Context_CHECKS_ACCESS(pycx))
+        {
+            CPyAutoObject pykey(PyInt_FromLong(idx));
+            if(pykey.isNull()) return JS_FALSE;
+            if(Context_has_access(pycx, jscx, pyobj, pykey) <= 0) return JS_FALSE;
+
+            // The access handler is free to change the list.
+            size = Py_SIZE(pyobj);
+            if(idx >= size) return js_get_prop(jscx, jsobj, keyid, rval);
+        }
+
+        item = PyList_Check(pyobj) ? PyList_GET_ITEM(pyobj, idx)
+                                   : PyTuple_GET_ITEM(pyobj, idx);
+
+        // Converting can run Python code that removes the item.
+        Py_INCREF(item);
+        CPyAutoObject held(item);
+        rval.set(py2js(pycx, held));
+        return !rval.isUndefined();
+    }
+
+    if(is_length_id(jscx, keyid))
+    {
+        if(Context_CHECKS_ACCESS(pycx))
+        {
+            CPyAutoObject pykey(PyString_FromString("length"));
+            if(pykey.isNull()) return JS_FALSE;
+            if(Context_has_access(pycx, jscx, pyobj, pykey) <= 0) return JS_FALSE;
+            size = Py_SIZE(pyobj);
+        }
+
+        rval.set(JS_NumberValue((double) size));
+        return JS_TRUE;
+    }
+
+    return js_get_prop(jscx, jsobj, keyid, rval);
+}
+
+JSBool
+js_list_set(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                JSBool strict, JS::MutableHandleValue rval)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyObject* pyobj = NULL;
+    PyObject* old = NULL;
+    int32_t idx;
+
+    if(!JSID_IS_INT(keyid)) return js_set_prop(jscx, jsobj, keyid, strict, rval);
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    pyobj = get_py_obj(jsobj);
+    if(pyobj == NULL) return JS_FALSE;
+
+    idx = JSID_TO_INT(keyid);
+    if(idx < 0 || idx >= PyList_GET_SIZE(pyobj))
+        return js_set_prop(jscx, jsobj, keyid, strict, rval);
+
+    if(Context_CHECKS_ACCESS(pycx))
+    {
+        CPyAutoObject pykey(PyInt_FromLong(idx));
+        if(pykey.isNull()) return JS_FALSE;
+        if(Context_has_access(pycx, jscx, pyobj, pykey) <= 0) return JS_FALSE;
+    }
+
+    CPyAutoObject pyval(js2py(pycx, rval));
+    if(pyval.isNull()) return JS_FALSE;
+
+    // Converting may have run Python code that shrank the list.
+    if(idx >= PyList_GET_SIZE(pyobj))
+        return js_set_prop(jscx, jsobj, keyid, strict, rval);
+
+    old = PyList_GET_ITEM(pyobj, idx);
+    PyList_SET_ITEM(pyobj, idx, pyval.asNew());
+    Py_DECREF(old);
+
+    return JS_TRUE;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_PYCONTAINER_H
+#define PYSM_PYCONTAINER_H
+
+/*
+    Property hooks for exact dicts, lists and tuples, installed by
+    create_class in place of the generic js_get_prop and js_set_prop.
+    Subclasses may override item access, so they keep the generic
+    hooks.
+*/
+
+JSBool js_dict_get(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JS::MutableHandleValue rval);
+JSBool js_dict_set(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JSBool strict, JS::MutableHandleValue rval);
+JSBool js_seq_get(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JS::MutableHandleValue rval);
+JSBool js_list_set(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JSBool strict, JS::MutableHandleValue rval);
+
+#endif
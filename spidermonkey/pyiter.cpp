@@ -23,6 +23,7 @@ get_js_slot(JSObject* obj, int slot)
 
 void finalize(JSFreeOp* jsfop, JSObject* jsobj)
 {
+    CPyAutoGIL gil;
     PyObject* pyobj;
     PyObject* pyiter;
 
@@ -59,6 +60,7 @@ JSBool is_for_of(JSContext* cx, JSObject* obj, JSBool* rval)
 
 JSBool def_next(JSContext* jscx, unsigned argc, jsval* vp)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pyobj = NULL;
     PyObject* iter = NULL;
@@ -115,6 +117,7 @@ JSBool def_next(JSContext* jscx, unsigned argc, jsval* vp)
 
 JSBool seq_next(JSContext* jscx, unsigned argc, jsval* vp)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pyobj = NULL;
     PyObject* iter = NULL;
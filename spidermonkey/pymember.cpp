@@ -0,0 +1,259 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+static int
+table_current(MemberTable* table, PyTypeObject* type)
+{
+    return table->versioned
+        && PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)
+        && type->tp_version_tag == table->version;
+}
+
+static PyObject*
+member_target(JSContext* jscx, JSObject* obj, jsid id, Context** pycx,
+                MemberTable** table, PyMemberDescrObject** descr)
+{
+    PyObject* pyobj = NULL;
+
+    *pycx = (Context*) JS_GetContextPrivate(jscx);
+    if(*pycx == NULL)
+    {
+        JS_ReportError(jscx, "Failed to get Python context.");
+        return NULL;
+    }
+
+    // Objects inheriting from one of our prototypes see no members.
+    if(JS_GetClass(obj)->finalize != js_finalize) return NULL;
+
+    pyobj = get_py_obj(obj);
+    if(pyobj == NULL) return NULL;
+
+    *table = (MemberTable*) PtrMap_get(&((*pycx)->members), Py_TYPE(pyobj));
+    if(*table == NULL || JSID_TO_INT(id) >= (*table)->count) return NULL;
+
+    *descr = (*table)->descrs[JSID_TO_INT(id)];
+    return pyobj;
+}
+
+static JSBool
+js_member_get(JSContext* jscx, JS::HandleObject obj, JS::HandleId id,
+                JS::MutableHandleValue vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyMemberDescrObject* descr = NULL;
+    PyMemberDef* member = NULL;
+    PyObject* pyobj = NULL;
+    MemberTable* table = NULL;
+    char* addr = NULL;
+    jsval rval;
+
+    vp.setUndefined();
+
+    pyobj = member_target(jscx, obj, id, &pycx, &table, &descr);
+    if(pyobj == NULL) return pycx != NULL;
+
+    if(Context_has_access(pycx, jscx, pyobj, descr->d_name) <= 0)
+        return JS_FALSE;
+
+    // Checked after the access handler, which may have rebound the
+    // attribute on the class itself.
+    if(!table_current(table, Py_TYPE(pyobj)))
+    {
+        CPyAutoObject val(PyObject_GetAttr(pyobj, descr->d_name));
+        if(val.isNull())
+        {
+            JS_ReportError(jscx, "Failed to read member.");
+            return JS_FALSE;
+        }
+        rval = py2js(pycx, val);
+        if(JSVAL_IS_VOID(rval))
+        {
+            JS_ReportError(jscx, "Failed to convert member value.");
+            return JS_FALSE;
+        }
+        vp.set(rval);
+        return JS_TRUE;
+    }
+
+    member = descr->d_member;
+    addr = ((char*) pyobj) + member->offset;
+
+    // The common cases convert straight from the instance memory.
+    switch(member->type)
+    {
+        case T_INT:
+            rval = INT_TO_JSVAL((int32_t) *((int*) addr));
+            break;
+        case T_DOUBLE:
+            rval = JS_NumberValue(*((double*) addr));
+            break;
+        case T_BOOL:
+            rval = *((char*) addr) ? JSVAL_TRUE : JSVAL_FALSE;
+            break;
+        case T_OBJECT:
+        case T_OBJECT_EX:
+        {
+            PyObject* val = *((PyObject**) addr);
+            // An unset slot reads like a missing attribute.
+            if(val == NULL)
+            {
+                if(member->type == T_OBJECT) vp.setNull();
+                return JS_TRUE;
+            }
+            rval = py2js(pycx, val);
+            break;
+        }
+        default:
+        {
+            CPyAutoObject val(PyMember_GetOne((char*) pyobj, member));
+            if(val.isNull())
+            {
+                JS_ReportError(jscx, "Failed to read member.");
+                return JS_FALSE;
+            }
+            rval = py2js(pycx, val);
+        }
+    }
+
+    if(JSVAL_IS_VOID(rval))
+    {
+        JS_ReportError(jscx, "Failed to convert member value.");
+        return JS_FALSE;
+    }
+
+    vp.set(rval);
+    return JS_TRUE;
+}
+
+static JSBool
+js_member_set(JSContext* jscx, JS::HandleObject obj, JS::HandleId id, JSBool strict,
+                JS::MutableHandleValue vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    PyMemberDescrObject* descr = NULL;
+    MemberTable* table = NULL;
+    PyObject* pyobj = NULL;
+    int failed;
+
+    pyobj = member_target(jscx, obj, id, &pycx, &table, &descr);
+    if(pyobj == NULL) return pycx != NULL;
+
+    if(Context_has_access(pycx, jscx, pyobj, descr->d_name) <= 0)
+        return JS_FALSE;
+
+    CPyAutoObject val(js2py(pycx, vp.get()));
+    if(val.isNull()) return JS_FALSE;
+
+    if(!table_current(table, Py_TYPE(pyobj)))
+    {
+        failed = PyObject_SetAttr(pyobj, descr->d_name, val) < 0;
+    }
+    else
+    {
+        // Checks READONLY and the member's type for us.
+        failed = PyMember_SetOne((char*) pyobj, descr->d_member, val) < 0;
+    }
+
+    if(failed)
+    {
+        JS_ReportError(jscx, "Failed to set member.");
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+/*
+    Walks the MRO the way attribute lookup does, so a member is only
+    exposed when no earlier class overrides its name.
+*/
+int
+define_members(Context* cx, JSObject* proto, PyTypeObject* type)
+{
+    MemberTable* table = NULL;
+    PyObject* mro = type->tp_mro;
+    PyObject* key;
+    PyObject* val;
+    Py_ssize_t pos;
+    Py_ssize_t i;
+    unsigned attrs = JSPROP_SHARED | JSPROP_PERMANENT | JSPROP_SHORTID;
+
+    if(mro == NULL) return 1;
+
+    CPyAutoObject seen(PyDict_New());
+    if(seen.isNull()) return 0;
+
+    for(i = 0; i < PyTuple_GET_SIZE(mro); i++)
+    {
+        PyTypeObject* base = (PyTypeObject*) PyTuple_GET_ITEM(mro, i);
+        if(base == &PyBaseObject_Type || base->tp_dict == NULL) continue;
+
+        pos = 0;
+        while(PyDict_Next(base->tp_dict, &pos, &key, &val))
+        {
+            if(PyDict_GetItem(seen, key) != NULL) continue;
+            if(PyDict_SetItem(seen, key, Py_None) < 0) goto error;
+
+            if(Py_TYPE(val) != &PyMemberDescr_Type || !PyString_Check(key)) continue;
+            if(table != NULL && table->count >= MEMBERS_MAX) continue;
+
+            if(table == NULL)
+            {
+                table = (MemberTable*) calloc(1, sizeof(MemberTable));
+                if(table == NULL)
+                {
+                    PyErr_NoMemory();
+                    goto error;
+                }
+                if(!PtrMap_put(&(cx->members), type, table))
+                {
+                    free(table);
+                    PyErr_NoMemory();
+                    goto error;
+                }
+            }
+
+            if(!JS_DefinePropertyWithTinyId(cx->cx, proto, PyString_AS_STRING(key),
+                    (int8_t) table->count, JSVAL_VOID, js_member_get, js_member_set,
+                    attrs))
+                goto error;
+
+            Py_INCREF(val);
+            table->descrs[table->count++] = (PyMemberDescrObject*) val;
+        }
+    }
+
+    // Looking a name up assigns the type a version tag if it can.
+    if(table != NULL)
+    {
+        _PyType_Lookup(type, table->descrs[0]->d_name);
+        if(PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG))
+        {
+            table->versioned = 1;
+            table->version = type->tp_version_tag;
+        }
+    }
+
+    return 1;
+
+error:
+    return 0;
+}
+
+void
+MemberTable_free(MemberTable* table)
+{
+    Py_ssize_t i;
+
+    for(i = 0; i < table->count; i++) Py_DECREF(table->descrs[i]);
+    free(table);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_PYMEMBER_H
+#define PYSM_PYMEMBER_H
+
+/*
+    Accessor properties for the PyMemberDef members of a type, which
+    include __slots__. They read and write the instance memory with
+    the member's own offset instead of looking the attribute up.
+*/
+
+// tinyids are signed bytes, later members use the generic path.
+#define MEMBERS_MAX 127
+
+// Holds a reference to each descriptor, the class attribute may be
+// rebound while the prototype still uses it. The type's version tag
+// tells whether it was: once it changes, members go through getattr.
+typedef struct {
+    Py_ssize_t count;
+    char versioned;             // Whether the type had a valid tag
+    unsigned int version;
+    PyMemberDescrObject* descrs[MEMBERS_MAX];
+} MemberTable;
+
+struct Context;
+
+int define_members(struct Context* cx, JSObject* proto, PyTypeObject* type);
+void MemberTable_free(MemberTable* table);
+
+#endif
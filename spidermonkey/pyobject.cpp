@@ -25,6 +25,7 @@ get_py_obj(JSObject* obj)
 
 JSBool js_del_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSBool *succeeded)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pyobj = NULL;
     jsval key;
@@ -58,12 +59,10 @@ JSBool js_del_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
 
 JSBool js_get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JS::MutableHandleValue rval)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     PyObject* pyobj = NULL;
     const char* data;
-    jsval key;
-
-    JS_IdToValue(jscx, keyid, &key);
 
     PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
     
@@ -71,7 +70,7 @@ JSBool js_get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
     if (pyobj == NULL) 
 	return JS_FALSE;
     
-    CPyAutoObject pykey(js2py(pycx, key));
+    CPyAutoObject pykey(js2py_key(pycx, keyid));
     if (pykey.isNull())
 	return JS_FALSE;
 
@@ -81,14 +80,9 @@ JSBool js_get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
     // Yeah. It's ugly as sin. 
     // (garyw: This is an old comment from somewhere.  Investigate.)
 
-    if (PyString_Check(pykey) || PyUnicode_Check(pykey)) {
-        CPyAutoObject utf8(PyUnicode_AsUTF8String(pykey));
-        if (utf8.isNull())
-	    return JS_FALSE;
-
-        data = PyString_AsString(utf8);
-        if (data == NULL) 
-	    return JS_FALSE;
+    // Both names are ASCII, so js2py_key made them a str.
+    if (PyString_Check(pykey)) {
+        data = PyString_AS_STRING((PyObject*) pykey);
 
         if (strcmp("iterator", data) == 0) {
             if (!new_py_iter(pycx, pyobj, rval, TRUE)) // use for-of style
@@ -127,6 +121,7 @@ JSBool js_get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
 JSBool js_set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid, JSBool strict, 
 		   JS::MutableHandleValue rval)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     jsval key;
 
@@ -166,10 +161,29 @@ JSBool js_set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
 
 void js_finalize(JSFreeOp*, JSObject* jsobj)
 {
+    CPyAutoGIL gil;
     PyObject* pyobj = NULL;
+    Context* pycx = NULL;
+    jsval slot;
+
+    // Never finished setting up, see py2js_object.
+    if (JSVAL_IS_VOID(JS_GetReservedSlot(jsobj, 0)))
+	return;
 
     pyobj = get_py_obj(jsobj);
-    Py_DECREF(pyobj);
+
+    slot = JS_GetReservedSlot(jsobj, 1);
+    if (JSVAL_IS_VOID(slot)) {
+	// Our Context is gone and left its reference to us.
+	Py_DECREF(pyobj);
+	return;
+    }
+
+    pycx = (Context*) JSVAL_TO_PRIVATE(slot);
+    if (PtrMap_get(&(pycx->jsobjects), pyobj) == jsobj)
+	PtrMap_remove(&(pycx->jsobjects), pyobj);
+
+    Context_release_object(pycx, JSVAL_TO_INT(JS_GetReservedSlot(jsobj, 2)));
 }
 
 PyObject* mk_args_tuple(Context* pycx, JSContext* jscx, unsigned argc, jsval* argv)
@@ -193,34 +207,108 @@ PyObject* mk_args_tuple(Context* pycx, JSContext* jscx, unsigned argc, jsval* ar
     return tpl.asNew();
 }
 
-JSBool js_call(JSContext* jscx, unsigned argc, jsval* vp)
+// Arguments converted onto the stack for the PyFunction fast path.
+#define FAST_CALL_MAX_ARGS 8
+
+static PyObject* call_name = NULL;
+static PyObject* init_name = NULL;
+
+static PyObject*
+interned(PyObject** cache, const char* name)
 {
-    Context* pycx = NULL;
-    jsval *argv = JS_ARGV(jscx, vp);
-    jsval funcobj = JS_CALLEE(jscx, vp);
+    if (*cache == NULL)
+	*cache = PyString_InternFromString(name);
+    return *cache;
+}
 
-    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+/*
+    Runs a Python function's code directly with the converted
+    arguments, without building the args tuple PyObject_Call needs.
+*/
+static PyObject*
+call_function(Context* pycx, PyObject* func, PyObject* self, unsigned argc, jsval* argv)
+{
+    PyObject* args[FAST_CALL_MAX_ARGS];
+    PyObject* defaults = PyFunction_GET_DEFAULTS(func);
+    PyObject* ret = NULL;
+    unsigned nargs = 0;
+    unsigned idx;
+
+    if (self != NULL)
+	args[nargs++] = Py_INCREF_RET(self);
+
+    for (idx = 0; idx < argc; idx++) {
+	args[nargs] = js2py(pycx, argv[idx]);
+	if (args[nargs] == NULL)
+	    goto done;
+	nargs++;
+    }
+
+    ret = PyEval_EvalCodeEx((PyCodeObject*) PyFunction_GET_CODE(func),
+			    PyFunction_GET_GLOBALS(func), NULL,
+			    args, nargs, NULL, 0,
+			    defaults ? &PyTuple_GET_ITEM(defaults, 0) : NULL,
+			    defaults ? PyTuple_GET_SIZE(defaults) : 0,
+			    PyFunction_GET_CLOSURE(func));
+
+done:
+    for (idx = 0; idx < nargs; idx++)
+	Py_DECREF(args[idx]);
+    return ret;
+}
+
+static PyObject*
+fast_call(Context* pycx, JSContext* jscx, PyObject* callable, unsigned argc, jsval* argv)
+{
+    if (PyCFunction_Check(callable)) {
+	int flags = PyCFunction_GET_FLAGS(callable) & ~(METH_CLASS | METH_STATIC | METH_COEXIST);
+	PyCFunction meth = PyCFunction_GET_FUNCTION(callable);
+	PyObject* self = PyCFunction_GET_SELF(callable);
+
+	if (flags == METH_NOARGS && argc == 0)
+	    return (*meth)(self, NULL);
+
+	if (flags == METH_O && argc == 1) {
+	    CPyAutoObject arg(js2py(pycx, argv[0]));
+	    if (arg.isNull())
+		return NULL;
+	    return (*meth)(self, arg);
+	}
+    } else if (PyFunction_Check(callable) && argc <= FAST_CALL_MAX_ARGS) {
+	return call_function(pycx, callable, NULL, argc, argv);
+    } else if (PyMethod_Check(callable) && PyMethod_GET_SELF(callable) != NULL
+	       && PyFunction_Check(PyMethod_GET_FUNCTION(callable))
+	       && argc < FAST_CALL_MAX_ARGS) {
+	return call_function(pycx, PyMethod_GET_FUNCTION(callable),
+			     PyMethod_GET_SELF(callable), argc, argv);
+    }
+
+    CPyAutoObject tpl(mk_args_tuple(pycx, jscx, argc, argv));
+    if (tpl.isNull())
+	return NULL;
+
+    return PyObject_Call(callable, tpl, NULL);
+}
+
+static JSBool
+call_python(Context* pycx, JSContext* jscx, PyObject* pyobj, unsigned argc, jsval* vp)
+{
+    jsval *argv = JS_ARGV(jscx, vp);
 
-    PyObject *pyobj = get_py_obj(JSVAL_TO_OBJECT(funcobj));
-    
     if(!PyCallable_Check(pyobj)) {
         JS_ReportError(jscx, "Object not callable, unable to apply");
 	return JS_FALSE;
     }
 
     // Use '__call__' as a notice that we want to execute a function.
-    CPyAutoObject attrcheck(PyString_FromString("__call__"));
-    if (attrcheck.isNull())
+    PyObject* attrcheck = interned(&call_name, "__call__");
+    if (attrcheck == NULL)
 	return JS_FALSE;
 
     if (Context_has_access(pycx, jscx, pyobj, attrcheck) <= 0) 
 	return JS_FALSE;
 
-    CPyAutoObject tpl(mk_args_tuple(pycx, jscx, argc, argv));
-    if (tpl.isNull())
-	return JS_FALSE;
-    
-    CPyAutoObject ret(PyObject_Call(pyobj, tpl, NULL));
+    CPyAutoObject ret(fast_call(pycx, jscx, pyobj, argc, argv));
     if (ret.isNull()){
 	if(!PyErr_Occurred()) {
             PyErr_SetString(PyExc_RuntimeError, "Failed to call object.");
@@ -240,8 +328,36 @@ JSBool js_call(JSContext* jscx, unsigned argc, jsval* vp)
     return JS_TRUE;
 }
 
+JSBool js_call(JSContext* jscx, unsigned argc, jsval* vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    jsval funcobj = JS_CALLEE(jscx, vp);
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    return call_python(pycx, jscx, get_py_obj(JSVAL_TO_OBJECT(funcobj)), argc, vp);
+}
+
+/*
+    The native behind the JSFunctions we export Python functions as.
+    Reserved slot 0 holds the wrapper object that owns the reference.
+*/
+JSBool js_call_function(JSContext* jscx, unsigned argc, jsval* vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    JSObject* callee = JSVAL_TO_OBJECT(JS_CALLEE(jscx, vp));
+    JSObject* wrapper = JSVAL_TO_OBJECT(js::GetFunctionNativeReserved(callee, 0));
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    return call_python(pycx, jscx, get_py_obj(wrapper), argc, vp);
+}
+
 JSBool js_ctor(JSContext* jscx, unsigned argc, jsval* vp)
 {
+    CPyAutoGIL gil;
     Context* pycx = NULL;
     jsval *argv = JS_ARGV(jscx, vp);
     jsval funcobj = JS_CALLEE(jscx, vp);
@@ -261,8 +377,8 @@ JSBool js_ctor(JSContext* jscx, unsigned argc, jsval* vp)
     }
 
     // Use '__init__' to signal use as a constructor.
-    CPyAutoObject attrcheck(PyString_FromString("__init__"));
-    if (attrcheck.isNull())
+    PyObject* attrcheck = interned(&init_name, "__init__");
+    if (attrcheck == NULL)
 	return JS_FALSE;
 
     if (Context_has_access(pycx, jscx, pyobj, attrcheck) <= 0) 
@@ -289,21 +405,203 @@ JSBool js_ctor(JSContext* jscx, unsigned argc, jsval* vp)
     return JS_TRUE;
 }
 
-void jsclass_finalizer(void *data)
+/*
+    Methods on a type's prototype dispatch by name, so one native
+    serves them all. Being shared, they are unbound: like JavaScript
+    methods they have to be called with the object as this.
+*/
+JSBool js_method(JSContext* jscx, unsigned argc, jsval* vp)
+{
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    JSObject* self = NULL;
+    JSFunction* func = NULL;
+    jsval *argv = JS_ARGV(jscx, vp);
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    self = JS_THIS_OBJECT(jscx, vp);
+    if (self == NULL || JS_GetClass(self)->finalize != js_finalize) {
+        JS_ReportError(jscx, "Python method called on an incompatible object, "
+                        "use bind() to pass it without its object.");
+	return JS_FALSE;
+    }
+
+    PyObject* pyobj = get_py_obj(self);
+
+    func = JS_ValueToFunction(jscx, JS_CALLEE(jscx, vp));
+    if (func == NULL)
+	return JS_FALSE;
+
+    CPyAutoObject pyname(js2py_string(pycx, STRING_TO_JSVAL(JS_GetFunctionId(func))));
+    if (pyname.isNull())
+	return JS_FALSE;
+
+    if (Context_has_access(pycx, jscx, pyobj, pyname) <= 0) 
+	return JS_FALSE;
+
+    CPyAutoObject meth(PyObject_GetAttr(pyobj, pyname));
+    if (meth.isNull()) {
+        JS_ReportError(jscx, "Failed to find method.");
+	return JS_FALSE;
+    }
+
+    CPyAutoObject tpl(mk_args_tuple(pycx, jscx, argc, argv));
+    if (tpl.isNull())
+	return JS_FALSE;
+
+    CPyAutoObject ret(PyObject_Call(meth, tpl, NULL));
+    if (ret.isNull()) {
+        JS_ReportError(jscx, "Failed to call method.");
+	return JS_FALSE;
+    }
+
+    jsval rval = py2js(pycx, ret);
+    JS_SET_RVAL(jscx, vp, rval);
+
+    if (JSVAL_IS_VOID(rval)) {
+        JS_ReportError(jscx, "Failed to convert Python return value.");
+	return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+/*
+    An instance __dict__ entry shadows a method of the same name, as it
+    does in Python. Such names are resolved as own accessors so they
+    aren't found on the prototype.
+*/
+static JSBool
+js_resolve_instance(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid)
 {
-    JSClass *jsc = (JSClass *)data;
-    free((void*)jsc->name);
-    free(jsc);
+    CPyAutoGIL gil;
+    Context* pycx = NULL;
+    JSObject* proto = NULL;
+    PyObject* pyobj = NULL;
+    PyObject** dictptr = NULL;
+    jsval val;
+
+    if (!JSID_IS_STRING(keyid))
+	return JS_TRUE;
+
+    PSM_GET_PRIVATE_CONTEXT(pycx, jscx, JS_FALSE);
+
+    pyobj = get_py_obj(jsobj);
+    if (pyobj == NULL)
+	return JS_TRUE;
+
+    dictptr = _PyObject_GetDictPtr(pyobj);
+    if (dictptr == NULL || *dictptr == NULL || PyDict_Size(*dictptr) == 0)
+	return JS_TRUE;
+
+    if (!JS_GetPrototype(jscx, jsobj, &proto))
+	return JS_FALSE;
+    if (proto == NULL)
+	return JS_TRUE;
+    if (!JS_LookupPropertyById(jscx, proto, keyid, &val))
+	return JS_FALSE;
+    if (!JSVAL_IS_OBJECT(val) || JSVAL_IS_NULL(val)
+	    || !JS_IsNativeFunction(JSVAL_TO_OBJECT(val), js_method))
+	return JS_TRUE;
+
+    CPyAutoObject pykey(js2py_key(pycx, keyid));
+    if (pykey.isNull()) {
+        JS_ReportError(jscx, "Failed to convert property name.");
+	return JS_FALSE;
+    }
+
+    if (PyDict_GetItem(*dictptr, pykey) == NULL)
+	return JS_TRUE;
+
+    return JS_DefinePropertyById(jscx, jsobj, keyid, JSVAL_VOID,
+				 js_get_prop, js_set_prop, JSPROP_SHARED);
+}
+
+/*
+    Only types whose attributes are plain class lookups get methods and
+    members on the prototype. Item access and __getattr__ are consulted
+    first by js_get_prop, which a prototype property would bypass.
+*/
+static int
+has_static_methods(PyTypeObject* type)
+{
+    if (type->tp_getattro != PyObject_GenericGetAttr)
+	return 0;
+    if (type->tp_as_mapping != NULL && type->tp_as_mapping->mp_subscript != NULL)
+	return 0;
+    if (type->tp_as_sequence != NULL && type->tp_as_sequence->sq_item != NULL)
+	return 0;
+    if (PyType_IsSubtype(type, &PyType_Type))
+	return 0;
+    return 1;
 }
 
+static int
+define_methods(Context* cx, JSObject* proto, PyTypeObject* type)
+{
+    PyObject* mro = type->tp_mro;
+    PyObject* key;
+    PyObject* val;
+    Py_ssize_t pos;
+    Py_ssize_t i;
+    JSBool found;
+
+    if (mro == NULL)
+	return 1;
+
+    CPyAutoObject seen(PyDict_New());
+    if (seen.isNull())
+	return 0;
+
+    // Earlier entries in the MRO win, whatever they bind the name to.
+    for (i = 0; i < PyTuple_GET_SIZE(mro); i++) {
+	PyTypeObject* base = (PyTypeObject*) PyTuple_GET_ITEM(mro, i);
+	if (base == &PyBaseObject_Type || base->tp_dict == NULL)
+	    continue;
+
+	pos = 0;
+	while (PyDict_Next(base->tp_dict, &pos, &key, &val)) {
+	    if (PyDict_GetItem(seen, key) != NULL)
+		continue;
+	    if (PyDict_SetItem(seen, key, Py_None) < 0)
+		return 0;
+
+	    if (!PyString_Check(key) || PyString_AS_STRING(key)[0] == '_')
+		continue;
+
+	    // Functions and method descriptors, not properties.
+	    if (!PyCallable_Check(val) || Py_TYPE(val)->tp_descr_get == NULL
+		    || Py_TYPE(val)->tp_descr_set != NULL)
+		continue;
+
+	    if (!JS_AlreadyHasOwnProperty(cx->cx, proto, PyString_AS_STRING(key), &found))
+		return 0;
+	    if (found)
+		continue;
+
+	    if (JS_DefineFunction(cx->cx, proto, PyString_AS_STRING(key), js_method, 0, 0) == NULL)
+		return 0;
+	}
+    }
+
+    return 1;
+}
+
+/*
+    One JSClass per Python type for the whole Runtime. The Runtime
+    keeps a reference to the type so the key stays valid, and frees
+    the classes after the last object using them is finalized.
+*/
 JSClass* create_class(Context* cx, PyObject* pyobj)
 {
-    PyObject* curr = NULL;
-    int flags = JSCLASS_HAS_RESERVED_SLOTS(1);
+    PyTypeObject* type = Py_TYPE(pyobj);
+    JSClass* curr = NULL;
+    int flags = JSCLASS_HAS_RESERVED_SLOTS(4);
 
-    curr = Context_get_class(cx, pyobj->ob_type->tp_name);
+    curr = (JSClass*) PtrMap_get(&(cx->rt->classes), type);
     if (curr != NULL) 
-	return (JSClass*) HashCObj_AsVoidPtr(curr);
+	return curr;
 
     CPyAutoFreeJSClassPtr jsclass((JSClass*) calloc(1, sizeof(JSClass)));
     if (jsclass.isNull()) {
@@ -311,13 +609,13 @@ JSClass* create_class(Context* cx, PyObject* pyobj)
 	return NULL;
     }
    
-    CPyAutoFreeCharPtr classname((char*) malloc(strlen(pyobj->ob_type->tp_name)+sizeof(char)));
+    CPyAutoFreeCharPtr classname((char*) malloc(strlen(type->tp_name)+sizeof(char)));
     if (classname.isNull()) {
         PyErr_NoMemory();
 	return NULL;
     }
     
-    strcpy((char*) classname, pyobj->ob_type->tp_name);
+    strcpy((char*) classname, type->tp_name);
     jsclass->name = classname;
     
     jsclass->flags = flags;
@@ -325,8 +623,23 @@ JSClass* create_class(Context* cx, PyObject* pyobj)
     jsclass->delProperty = js_del_prop;
     jsclass->getProperty = js_get_prop;
     jsclass->setProperty = js_set_prop;
+
+    if (type == &PyDict_Type) {
+	jsclass->getProperty = js_dict_get;
+	jsclass->setProperty = js_dict_set;
+    } else if (type == &PyList_Type) {
+	jsclass->getProperty = js_seq_get;
+	jsclass->setProperty = js_list_set;
+    } else if (type == &PyTuple_Type) {
+	jsclass->getProperty = js_seq_get;
+    }
     jsclass->enumerate = JS_EnumerateStub;
     jsclass->resolve = JS_ResolveStub;
+
+    // Instances with a __dict__ can shadow methods on the prototype.
+    if (type->tp_dictoffset != 0
+	    && (has_static_methods(type) || Binding_Find(&(cx->rt->bindings), type) != NULL))
+	jsclass->resolve = js_resolve_instance;
     jsclass->convert = JS_ConvertStub;
     jsclass->finalize = js_finalize;
 
@@ -335,17 +648,67 @@ JSClass* create_class(Context* cx, PyObject* pyobj)
     jsclass->call = js_call;
     jsclass->construct = js_ctor;
     
-    curr = HashCObj_FromVoidPtr(jsclass, jsclass_finalizer);
-    if (curr == NULL) 
-	return NULL;
-
-    if (Context_add_class(cx, pyobj->ob_type->tp_name, curr) < 0) 
+    if (!PtrMap_put(&(cx->rt->classes), type, jsclass)) {
+        PyErr_NoMemory();
 	return NULL;
+    }
+    Py_INCREF(type);
 
     classname.steal();
     return jsclass.steal();
 }
 
+/*
+    The prototype for a type's wrappers in this Context, created on
+    first use. Sharing it lets the engine share shapes between them.
+*/
+JSObject* get_proto(Context* cx, PyTypeObject* type)
+{
+    jsval* slot = (jsval*) PtrMap_get(&(cx->protos), type);
+    JSObject* proto = NULL;
+    Binding* binding = NULL;
+
+    if (slot != NULL)
+	return JSVAL_TO_OBJECT(*slot);
+
+    proto = JS_NewObject(cx->cx, NULL, NULL, NULL);
+    if (proto == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create prototype.");
+	return NULL;
+    }
+
+    slot = RootArena_add(&(cx->roots), OBJECT_TO_JSVAL(proto));
+    if (slot == NULL)
+	return NULL;
+
+    if (!PtrMap_put(&(cx->protos), type, slot)) {
+	RootArena_release(&(cx->roots), slot);
+        PyErr_NoMemory();
+	return NULL;
+    }
+
+    binding = Binding_Find(&(cx->rt->bindings), type);
+    if (binding != NULL) {
+	if (!PtrMap_put(&(cx->bound), type, binding)) {
+	    PyErr_NoMemory();
+	    return NULL;
+	}
+	if (!Binding_define(cx, proto, binding)) {
+	    if (!PyErr_Occurred())
+		PyErr_SetString(PyExc_RuntimeError, "Failed to define bound properties.");
+	    return NULL;
+	}
+    } else if (has_static_methods(type)) {
+	if (!define_members(cx, proto, type) || !define_methods(cx, proto, type)) {
+	    if (!PyErr_Occurred())
+		PyErr_SetString(PyExc_RuntimeError, "Failed to define methods.");
+	    return NULL;
+	}
+    }
+
+    return proto;
+}
+
 PyObject* unwrap_pyobject(jsval val)
 {
     PyObject* ret = NULL;
@@ -353,6 +716,8 @@ PyObject* unwrap_pyobject(jsval val)
     JSObject* obj = NULL;
 
     obj = JSVAL_TO_OBJECT(val);
+    if (JS_IsNativeFunction(obj, js_call_function))
+	obj = JSVAL_TO_OBJECT(js::GetFunctionNativeReserved(obj, 0));
     klass = JS_GetClass(obj);
 
     if (klass->finalize == js_finalize)
@@ -363,33 +728,113 @@ PyObject* unwrap_pyobject(jsval val)
     return ret;
 }
 
+/*
+    Python functions are handed to JavaScript as real JSFunctions, so
+    calls skip the class call hook and Function.prototype applies. The
+    wrapper object still owns the Python reference; it stays alive
+    through the function's reserved slot and points back to it from
+    slot 3.
+*/
+static int
+export_function(Context* cx, PyObject* pyobj, JSObject* wrapper)
+{
+    JSFunction* func = NULL;
+    JSObject* funcobj = NULL;
+    const char* name = NULL;
+    unsigned nargs = 0;
+    int bound = 0;
+
+    if (PyMethod_Check(pyobj)) {
+	bound = PyMethod_GET_SELF(pyobj) != NULL;
+	pyobj = PyMethod_GET_FUNCTION(pyobj);
+    }
+
+    if (PyFunction_Check(pyobj)) {
+	PyCodeObject* code = (PyCodeObject*) PyFunction_GET_CODE(pyobj);
+	name = PyString_AsString(((PyFunctionObject*) pyobj)->func_name);
+	nargs = code->co_argcount;
+	// A bound method's first argument is already filled in.
+	if (bound && nargs > 0)
+	    nargs--;
+    } else if (PyCFunction_Check(pyobj)) {
+	name = ((PyCFunctionObject*) pyobj)->m_ml->ml_name;
+	nargs = (PyCFunction_GET_FLAGS(pyobj) & METH_O) ? 1 : 0;
+    }
+    if (name == NULL)
+	PyErr_Clear();
+
+    func = js::NewFunctionWithReserved(cx->cx, js_call_function, nargs, 0, cx->root, name);
+    if (func == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create JS function.");
+	return 0;
+    }
+
+    funcobj = JS_GetFunctionObject(func);
+    js::SetFunctionNativeReserved(funcobj, 0, OBJECT_TO_JSVAL(wrapper));
+    JS_SetReservedSlot(wrapper, 3, OBJECT_TO_JSVAL(funcobj));
+    return 1;
+}
+
+static jsval
+exported_value(JSObject* jsobj)
+{
+    jsval func = JS_GetReservedSlot(jsobj, 3);
+    return JSVAL_IS_OBJECT(func) && !JSVAL_IS_NULL(func) ? func : OBJECT_TO_JSVAL(jsobj);
+}
+
 jsval py2js_object(Context* cx, PyObject* pyobj)
 {
     JSClass* klass = NULL;
     JSObject* jsobj = NULL;
-    jsval pyval;
+    JSObject* proto = NULL;
+    Py_ssize_t handle;
+
+    /*
+        Reuse the object wrapping pyobj if there is one. Not while an
+        incremental GC is running though: our table is weak, and an
+        object that was unreachable when marking started must not be
+        handed out again.
+    */
+    if (!JS::IsIncrementalGCInProgress(cx->rt->rt)) {
+	jsobj = (JSObject*) PtrMap_get(&(cx->jsobjects), pyobj);
+	if (jsobj != NULL)
+	    return exported_value(jsobj);
+    }
    
     klass = create_class(cx, pyobj);
     if (klass == NULL) 
 	return JSVAL_VOID;
 
-    jsobj = JS_NewObject(cx->cx, klass, NULL, NULL);
+    proto = get_proto(cx, Py_TYPE(pyobj));
+    if (proto == NULL)
+	return JSVAL_VOID;
+
+    jsobj = JS_NewObject(cx->cx, klass, proto, NULL);
     if (jsobj == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to create JS object.");
 	return JSVAL_VOID;
     }
 
-    if (Context_add_object(cx, pyobj) < 0) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to store reference.");
+    // The handle's reference is released by js_finalize.
+    handle = Context_add_object(cx, pyobj, jsobj);
+    if (handle < 0)
+	return JSVAL_VOID;
+
+    JS_SetReservedSlot(jsobj, 0, PRIVATE_TO_JSVAL(pyobj));
+    JS_SetReservedSlot(jsobj, 1, PRIVATE_TO_JSVAL(cx));
+    JS_SetReservedSlot(jsobj, 2, INT_TO_JSVAL((int32_t) handle));
+
+    if (!PtrMap_put(&(cx->jsobjects), pyobj, jsobj)) {
+	PyErr_NoMemory();
 	return JSVAL_VOID;
     }
 
-    Py_INCREF(pyobj);	/* This INCREF gets released by js_finalize */
-    
-    pyval = PRIVATE_TO_JSVAL(pyobj);
-    JS_SetReservedSlot(jsobj, 0, pyval);
+    if (PyFunction_Check(pyobj) || PyCFunction_Check(pyobj) || PyMethod_Check(pyobj)) {
+	if (!export_function(cx, pyobj, jsobj))
+	    return JSVAL_VOID;
+    }
 
-    return OBJECT_TO_JSVAL(jsobj);
+    return exported_value(jsobj);
 }
 
 
@@ -17,4 +17,13 @@
 jsval py2js_object(Context* cx, PyObject* obj);
 PyObject* unwrap_pyobject(jsval val);
 
+PyObject* get_py_obj(JSObject* obj);
+JSBool js_get_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JS::MutableHandleValue rval);
+JSBool js_set_prop(JSContext* jscx, JS::HandleObject jsobj, JS::HandleId keyid,
+                    JSBool strict, JS::MutableHandleValue rval);
+void js_finalize(JSFreeOp* fop, JSObject* jsobj);
+JSBool js_method(JSContext* jscx, unsigned argc, jsval* vp);
+JSBool js_call_function(JSContext* jscx, unsigned argc, jsval* vp);
+
 #endif
@@ -79,3 +79,17 @@ class CPyAutoFree
 
 typedef CPyAutoFree<JSClass> CPyAutoFreeJSClassPtr;
 typedef CPyAutoFree<char> CPyAutoFreeCharPtr;
+
+// Holds the GIL for the lifetime of the object.  JavaScript runs with the GIL
+// released, so every callback which comes back into Python must take it
+// first.  Declare it before any CPyAuto objects so it is released last.
+
+class CPyAutoGIL
+{
+  public:
+    CPyAutoGIL() { m_state = PyGILState_Ensure(); }
+    ~CPyAutoGIL() { PyGILState_Release(m_state); }
+
+  protected:
+    PyGILState_STATE m_state;
+};
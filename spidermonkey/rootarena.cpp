@@ -0,0 +1,93 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+void
+RootArena_init(RootArena* arena)
+{
+    arena->chunks = NULL;
+    arena->free_slot = NULL;
+    arena->live = 0;
+}
+
+jsval*
+RootArena_add(RootArena* arena, jsval val)
+{
+    RootChunk* chunk = NULL;
+    jsval* slot = NULL;
+    int i;
+
+    if(arena->free_slot == NULL)
+    {
+        chunk = (RootChunk*) malloc(sizeof(RootChunk));
+        if(chunk == NULL)
+        {
+            PyErr_NoMemory();
+            return NULL;
+        }
+
+        for(i = 0; i < ROOT_CHUNK_SLOTS; i++)
+        {
+            chunk->slots[i] = PRIVATE_TO_JSVAL(
+                    i + 1 < ROOT_CHUNK_SLOTS ? &(chunk->slots[i + 1]) : NULL);
+        }
+
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->free_slot = &(chunk->slots[0]);
+    }
+
+    slot = arena->free_slot;
+    arena->free_slot = (jsval*) JSVAL_TO_PRIVATE(*slot);
+
+    *slot = val;
+    arena->live++;
+    return slot;
+}
+
+void
+RootArena_release(RootArena* arena, jsval* slot)
+{
+    *slot = PRIVATE_TO_JSVAL(arena->free_slot);
+    arena->free_slot = slot;
+    arena->live--;
+}
+
+void
+RootArena_trace(RootArena* arena, JSTracer* trc)
+{
+    RootChunk* chunk;
+    int i;
+
+    for(chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+    {
+        for(i = 0; i < ROOT_CHUNK_SLOTS; i++)
+        {
+            if(JSVAL_IS_GCTHING(chunk->slots[i]))
+            {
+                JS_CallValueTracer(trc, &(chunk->slots[i]), "RootArena");
+            }
+        }
+    }
+}
+
+void
+RootArena_free(RootArena* arena)
+{
+    RootChunk* next;
+
+    while(arena->chunks != NULL)
+    {
+        next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    RootArena_init(arena);
+}
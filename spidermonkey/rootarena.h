@@ -0,0 +1,43 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_ROOTARENA_H
+#define PYSM_ROOTARENA_H
+
+/*
+    GC roots for a Context's wrapper objects. Slots live in fixed
+    size chunks that are never moved, so a wrapper can keep a pointer
+    to its slot. Free slots hold the next free slot as a private
+    value, which the tracer skips like any other non-GC value.
+
+    The Runtime traces every Context's arena from its extra roots
+    tracer, so taking and releasing a slot is O(1) and never touches
+    the runtime's root table.
+*/
+
+#define ROOT_CHUNK_SLOTS 256
+
+typedef struct RootChunk {
+    struct RootChunk* next;
+    jsval slots[ROOT_CHUNK_SLOTS];
+} RootChunk;
+
+typedef struct {
+    RootChunk* chunks;
+    jsval* free_slot;
+    Py_ssize_t live;
+} RootArena;
+
+void RootArena_init(RootArena* arena);
+// Returns NULL with an exception set when out of memory.
+jsval* RootArena_add(RootArena* arena, jsval val);
+void RootArena_release(RootArena* arena, jsval* slot);
+void RootArena_trace(RootArena* arena, JSTracer* trc);
+void RootArena_free(RootArena* arena);
+
+#endif
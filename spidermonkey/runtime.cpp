@@ -8,13 +8,206 @@
 
 #include "spidermonkey.h"
 
+#include <sys/time.h>
+
+// How often an expired deadline is re-triggered while its context is
+// busy in Python and cannot see the operation callback.
+#define WATCHDOG_RETRIGGER_MS 5
+
+int64_t
+Runtime_now_ms(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return ((int64_t) now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+static void*
+Runtime_watchdog(void* arg)
+{
+    Runtime* self = (Runtime*) arg;
+    Context* cx;
+    struct timespec until;
+    int64_t now;
+    int64_t next;
+    int fire;
+
+    pthread_mutex_lock(&self->watch_lock);
+
+    while(!self->watchdog_stopping)
+    {
+        now = Runtime_now_ms();
+        next = 0;
+        fire = 0;
+
+        for(cx = self->watched; cx != NULL; cx = cx->watch_next)
+        {
+            if(cx->deadline <= now)
+            {
+                cx->timed_out = 1;
+                fire = 1;
+                if(next == 0 || now + WATCHDOG_RETRIGGER_MS < next)
+                    next = now + WATCHDOG_RETRIGGER_MS;
+            }
+            else if(next == 0 || cx->deadline < next)
+            {
+                next = cx->deadline;
+            }
+        }
+
+        if(fire) JS_TriggerOperationCallback(self->rt);
+
+        if(next == 0)
+        {
+            pthread_cond_wait(&self->watch_cond, &self->watch_lock);
+        }
+        else
+        {
+            until.tv_sec = next / 1000;
+            until.tv_nsec = (next % 1000) * 1000000;
+            pthread_cond_timedwait(&self->watch_cond, &self->watch_lock, &until);
+        }
+    }
+
+    pthread_mutex_unlock(&self->watch_lock);
+    return NULL;
+}
+
+/*
+    Set or clear (deadline == 0) the deadline of a context and
+    (un)register it with the watchdog, starting it when needed.
+*/
+int
+Runtime_set_deadline(Runtime* self, Context* cx, int64_t deadline)
+{
+    Context** curr;
+    int ret = 1;
+
+    pthread_mutex_lock(&self->watch_lock);
+
+    if(cx->deadline == 0 && deadline != 0)
+    {
+        cx->watch_next = self->watched;
+        self->watched = cx;
+    }
+    else if(cx->deadline != 0 && deadline == 0)
+    {
+        for(curr = &self->watched; *curr != NULL; curr = &(*curr)->watch_next)
+        {
+            if(*curr == cx)
+            {
+                *curr = cx->watch_next;
+                break;
+            }
+        }
+        cx->watch_next = NULL;
+    }
+
+    cx->deadline = deadline;
+    cx->timed_out = 0;
+
+    if(deadline != 0 && !self->watchdog_running)
+    {
+        if(pthread_create(&self->watchdog, NULL, Runtime_watchdog, self) == 0)
+        {
+            self->watchdog_running = 1;
+        }
+        else
+        {
+            ret = 0;
+        }
+    }
+
+    pthread_cond_signal(&self->watch_cond);
+    pthread_mutex_unlock(&self->watch_lock);
+
+    if(!ret) PyErr_SetString(PyExc_RuntimeError, "Failed to start watchdog thread.");
+    return ret;
+}
+
+static void
+Runtime_trace_roots(JSTracer* trc, void* data)
+{
+    Runtime* self = (Runtime*) data;
+    Context* cx;
+
+    for(cx = self->contexts; cx != NULL; cx = cx->rt_next)
+    {
+        RootArena_trace(&(cx->roots), trc);
+        KeyCache_trace(&(cx->keys), trc);
+    }
+}
+
+/*
+    A collection can free atoms and reuse their addresses, so every
+    Context marks the global names it cached as missing stale. They
+    hold Python references, which are dropped later with the GIL.
+*/
+static void
+Runtime_gc_callback(JSRuntime* rt, JSGCStatus status)
+{
+    Runtime* self = (Runtime*) JS_GetRuntimePrivate(rt);
+    Context* cx;
+
+    if(self == NULL) return;
+
+    for(cx = self->contexts; cx != NULL; cx = cx->rt_next)
+    {
+        cx->misses_stale = 1;
+    }
+}
+
+void
+Runtime_add_context(Runtime* self, Context* cx)
+{
+    cx->rt_next = self->contexts;
+    self->contexts = cx;
+}
+
+void
+Runtime_remove_context(Runtime* self, Context* cx)
+{
+    Context** curr;
+
+    for(curr = &(self->contexts); *curr != NULL; curr = &((*curr)->rt_next))
+    {
+        if(*curr == cx)
+        {
+            *curr = cx->rt_next;
+            break;
+        }
+    }
+
+    cx->rt_next = NULL;
+}
+
 PyObject*
 Runtime_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
 {
     Runtime* self = NULL;
     unsigned int stacksize = 0x2000000; // 32 MiB heap size.
+    int helper_threads = 0;
+    int parallel_compilation = 1;
+    int incremental_gc = 0;
+
+    const char* keywords[] = {"stacksize", "helper_threads",
+                    "parallel_compilation", "incremental_gc", NULL};
 
-    if (!PyArg_ParseTuple(args, "|I", &stacksize)) goto error;
+    if (!PyArg_ParseTupleAndKeywords(
+        args, kwargs,
+        "|Iiii",
+        (char **)keywords,
+        &stacksize,
+        &helper_threads,
+        &parallel_compilation,
+        &incremental_gc
+    )) goto error;
+
+    if (helper_threads < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "helper_threads must not be negative.");
+        goto error;
+    }
 
 #ifdef SPIDERMONKEY_31
     if (!JS_Init())
@@ -27,13 +220,33 @@ Runtime_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     self = (Runtime*) type->tp_alloc(type, 0);
     if(self == NULL) goto error;
 
-    self->rt = JS_NewRuntime(stacksize, JS_NO_HELPER_THREADS);
+    self->rt = JS_NewRuntime(stacksize,
+            helper_threads > 0 ? JS_USE_HELPER_THREADS : JS_NO_HELPER_THREADS);
     if(self->rt == NULL)
     {
         PyErr_SetString(JSError, "Failed to allocate new JSRuntime.");
         goto error;
     }
 
+    self->thread = PyThread_get_thread_ident();
+
+    self->helper_threads = helper_threads;
+    self->parallel_compilation = helper_threads > 0 && parallel_compilation;
+    self->incremental_gc = incremental_gc != 0;
+
+    // Incremental GC lets sweeping overlap with execution on the helpers.
+    if(self->incremental_gc)
+    {
+        JS_SetGCParameter(self->rt, JSGC_MODE, JSGC_MODE_INCREMENTAL);
+    }
+
+    JS_SetExtraGCRootsTracer(self->rt, Runtime_trace_roots, self);
+    JS_SetRuntimePrivate(self->rt, self);
+    JS_SetGCCallback(self->rt, Runtime_gc_callback);
+
+    pthread_mutex_init(&self->watch_lock, NULL);
+    pthread_cond_init(&self->watch_cond, NULL);
+
     goto success;
 
 error:
@@ -53,10 +266,44 @@ Runtime_init(Runtime* self, PyObject* args, PyObject* kwargs)
 void
 Runtime_dealloc(Runtime* self)
 {
+    if(self->watchdog_running)
+    {
+        pthread_mutex_lock(&self->watch_lock);
+        self->watchdog_stopping = 1;
+        pthread_cond_signal(&self->watch_cond);
+        pthread_mutex_unlock(&self->watch_lock);
+        pthread_join(self->watchdog, NULL);
+    }
+
+    Py_CLEAR(self->cache_dir);
+
     if(self->rt != NULL)
     {
+        ScriptCache_clear(&(self->scripts), self->rt);
         JS_DestroyRuntime(self->rt);
+        pthread_cond_destroy(&self->watch_cond);
+        pthread_mutex_destroy(&self->watch_lock);
     }
+
+    // Only now is every object using these classes finalized.
+    PtrMapEntry* entry;
+    PtrMap_FOREACH(&(self->classes), entry)
+    {
+        JSClass* klass = (JSClass*) entry->value;
+        free((void*) klass->name);
+        free(klass);
+        Py_DECREF((PyObject*) entry->key);
+    }
+    PtrMap_free(&(self->classes));
+
+    PtrMap_FOREACH(&(self->bindings), entry)
+    {
+        Binding_Free((Binding*) entry->value);
+        Py_DECREF((PyObject*) entry->key);
+    }
+    PtrMap_free(&(self->bindings));
+
+    self->ob_type->tp_free((PyObject*) self);
 }
 
 PyObject*
@@ -64,33 +311,231 @@ Runtime_new_context(Runtime* self, PyObject* args, PyObject* kwargs)
 {
     PyObject* cx = NULL;
     PyObject* tpl = NULL;
+    PyObject* kw = NULL;
     PyObject* global = Py_None;
     PyObject* access = Py_None;
+    int materialize = 0;
 
-    const char* const keywords[] = {"glbl", "access", NULL};
+    const char* const keywords[] = {"glbl", "access", "materialize", NULL};
 
     if(!PyArg_ParseTupleAndKeywords(
         args, kwargs,
-        "|OO",
+        "|OOi",
         (char **)keywords,	// These can be eliminated when Python updates their API headers
         &global,
-        &access
+        &access,
+        &materialize
     )) goto error;
 
     tpl = Py_BuildValue("OOO", self, global, access);
     if(tpl == NULL) goto error;
 
-    cx = PyObject_CallObject((PyObject*) ContextType, tpl);
+    kw = Py_BuildValue("{s:i}", "materialize", materialize);
+    if(kw == NULL) goto error;
+
+    cx = PyObject_Call((PyObject*) ContextType, tpl, kw);
     goto success;
 
 error:
     Py_XDECREF(cx);
+    cx = NULL;
 
 success:
     Py_XDECREF(tpl);
+    Py_XDECREF(kw);
     return cx;
 }
 
+PyObject*
+Runtime_context_pool(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* ret = NULL;
+    PyObject* tpl = NULL;
+
+    tpl = PyTuple_New(PyTuple_GET_SIZE(args) + 1);
+    if(tpl == NULL) return NULL;
+
+    PyTuple_SET_ITEM(tpl, 0, Py_INCREF_RET((PyObject*) self));
+    for(Py_ssize_t i = 0; i < PyTuple_GET_SIZE(args); i++)
+    {
+        PyTuple_SET_ITEM(tpl, i + 1, Py_INCREF_RET(PyTuple_GET_ITEM(args, i)));
+    }
+
+    ret = PyObject_Call((PyObject*) ContextPoolType, tpl, kwargs);
+    Py_DECREF(tpl);
+    return ret;
+}
+
+PyObject*
+Runtime_helper_status(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    const char* gc_mode;
+
+    switch(JS_GetGCParameter(self->rt, JSGC_MODE))
+    {
+        case JSGC_MODE_GLOBAL:
+            gc_mode = "global";
+            break;
+        case JSGC_MODE_COMPARTMENT:
+            gc_mode = "compartment";
+            break;
+        case JSGC_MODE_INCREMENTAL:
+            gc_mode = "incremental";
+            break;
+        default:
+            gc_mode = "unknown";
+    }
+
+    // mozjs-24 doesn't expose whether helper threads actually run, it
+    // skips them on single core machines. Only what the runtime was
+    // allowed to do is known here, the GC fields come from the engine.
+    return Py_BuildValue("{s:i,s:O,s:O,s:s,s:I}",
+        "helper_threads_requested", self->helper_threads,
+        "off_thread_compilation_allowed", self->parallel_compilation ? Py_True : Py_False,
+        "background_sweeping_allowed", self->helper_threads > 0 ? Py_True : Py_False,
+        "gc_mode", gc_mode,
+        "gc_number", JS_GetGCParameter(self->rt, JSGC_NUMBER)
+    );
+}
+
+PyObject*
+Runtime_cache_dir(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* ret = NULL;
+    PyObject* newval = NULL;
+
+    if(!PyArg_ParseTuple(args, "|O", &newval)) return NULL;
+
+    if(newval != NULL && newval != Py_None && !PyString_Check(newval))
+    {
+        PyErr_SetString(PyExc_TypeError, "Cache directory must be a string.");
+        return NULL;
+    }
+
+    ret = self->cache_dir;
+    if(ret == NULL) ret = Py_INCREF_RET(Py_None);
+
+    if(newval != NULL)
+    {
+        if(newval == Py_None)
+        {
+            self->cache_dir = NULL;
+        }
+        else
+        {
+            Py_INCREF(newval);
+            self->cache_dir = newval;
+        }
+    }
+    else if(ret != Py_None)
+    {
+        Py_INCREF(ret);
+    }
+
+    return ret;
+}
+
+PyObject*
+Runtime_script_cache(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    Py_ssize_t prev = self->scripts.size;
+    Py_ssize_t size = -1;
+
+    if(!PyArg_ParseTuple(args, "|n", &size)) return NULL;
+
+    if(PyTuple_GET_SIZE(args) > 0)
+    {
+        if(!ScriptCache_resize(&(self->scripts), self->rt, size)) return NULL;
+    }
+
+    return PyInt_FromSsize_t(prev);
+}
+
+PyObject*
+Runtime_script_cache_stats(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    return ScriptCache_stats(&(self->scripts));
+}
+
+PyObject*
+Runtime_register_class(Runtime* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* type = NULL;
+    PyObject* properties = NULL;
+    PyObject* methods = NULL;
+    PyObject* readonly = NULL;
+    PyObject* props = NULL;
+    PyObject* ret = NULL;
+    Binding* binding = NULL;
+
+    const char* keywords[] = {"type", "properties", "methods", "readonly", NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(
+        args, kwargs,
+        "O!|OOO",
+        (char**) keywords,
+        &PyType_Type,
+        &type,
+        &properties,
+        &methods,
+        &readonly
+    )) goto error;
+
+    if(PtrMap_get(&(self->bindings), type) != NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "Type is already registered.");
+        goto error;
+    }
+
+    // A plain list of names converts each attribute generically.
+    if(properties == NULL || properties == Py_None)
+    {
+        props = PyDict_New();
+    }
+    else if(PyDict_Check(properties))
+    {
+        props = Py_INCREF_RET(properties);
+    }
+    else
+    {
+        props = PyDict_New();
+        if(props == NULL) goto error;
+        CPyAutoObject iter(PyObject_GetIter(properties));
+        if(iter.isNull()) goto error;
+        PyObject* name;
+        while((name = PyIter_Next(iter)) != NULL)
+        {
+            int status = PyDict_SetItem(props, name, Py_None);
+            Py_DECREF(name);
+            if(status < 0) goto error;
+        }
+        if(PyErr_Occurred()) goto error;
+    }
+    if(props == NULL) goto error;
+
+    if(readonly == Py_None) readonly = NULL;
+    binding = Binding_New(props, methods, readonly);
+    if(binding == NULL) goto error;
+
+    if(!PtrMap_put(&(self->bindings), type, binding))
+    {
+        Binding_Free(binding);
+        PyErr_NoMemory();
+        goto error;
+    }
+    Py_INCREF(type);
+
+    ret = Py_INCREF_RET(Py_None);
+    goto success;
+
+error:
+    ret = NULL;
+
+success:
+    Py_XDECREF(props);
+    return ret;
+}
+
 static PyMemberDef Runtime_members[] = {
     {NULL}
 };
@@ -100,8 +545,55 @@ static PyMethodDef Runtime_methods[] = {
         "new_context",
         (PyCFunction)Runtime_new_context,
         METH_VARARGS | METH_KEYWORDS,
+        "new_context(glbl=None, access=None, materialize=False)\n"
         "Create a new JavaScript Context."
     },
+    {
+        "cache_dir",
+        (PyCFunction)Runtime_cache_dir,
+        METH_VARARGS,
+        "Get/Set the directory Context.compile caches bytecode in. "
+        "None disables the cache."
+    },
+    {
+        "context_pool",
+        (PyCFunction)Runtime_context_pool,
+        METH_VARARGS | METH_KEYWORDS,
+        "context_pool(size, bootstrap=None, glbl=None, access=None)\n"
+        "Create a ContextPool of bootstrapped contexts."
+    },
+    {
+        "script_cache",
+        (PyCFunction)Runtime_script_cache,
+        METH_VARARGS,
+        "Get/Set how many compiled scripts Context.execute keeps per "
+        "source, filename and line number. 0 disables the cache. A script "
+        "is compiled against the global of the context that missed; hits "
+        "from other contexts run a clone of it."
+    },
+    {
+        "script_cache_stats",
+        (PyCFunction)Runtime_script_cache_stats,
+        METH_NOARGS,
+        "Return the script cache size, entry count, hits, misses and evictions."
+    },
+    {
+        "register_class",
+        (PyCFunction)Runtime_register_class,
+        METH_VARARGS | METH_KEYWORDS,
+        "register_class(type, properties=None, methods=None, readonly=None)\n"
+        "Declare the attributes and methods JavaScript uses on instances "
+        "of type. properties maps names to 'int', 'float', 'bool', 'str' "
+        "or None for any value. Only affects prototypes created later."
+    },
+    {
+        "helper_status",
+        (PyCFunction)Runtime_helper_status,
+        METH_NOARGS,
+        "Report the helper threads requested, which work the runtime may "
+        "move off the main thread, and the engine's GC mode and count. "
+        "Whether the engine uses the helpers also depends on the CPU count."
+    },
     {NULL}
 };
 
@@ -12,13 +12,57 @@
 #include <Python.h>
 #include "structmember.h"
 
+#include "pythread.h"
+
 #include <jsapi.h>
 
+#include "scriptcache.h"
+#include "ptrmap.h"
+
+#include <pthread.h>
+
+struct Context;
+
 typedef struct {
     PyObject_HEAD
     JSRuntime* rt;
+    long thread;    // A JSRuntime may only be used from the thread that created it.
+
+    // Off-main-thread work. mozjs sizes its helper pool itself, so
+    // helper_threads is only the requested count (0 disables them).
+    int helper_threads;
+    char parallel_compilation;
+    char incremental_gc;
+
+    PyObject* cache_dir;    // Bytecode cache directory for Context.compile.
+    ScriptCache scripts;    // Compiled sources for Context.execute.
+
+    // Watchdog thread, started on the first deadline. It triggers the
+    // operation callback when a watched context's deadline passes.
+    pthread_t watchdog;
+    pthread_mutex_t watch_lock;
+    pthread_cond_t watch_cond;
+    char watchdog_running;
+    char watchdog_stopping;
+    struct Context* watched;
+
+    // Every live Context, for tracing their root arenas.
+    struct Context* contexts;
+
+    // PyTypeObject* -> JSClass* for wrapped Python objects, holding a
+    // reference to each type. See create_class.
+    PtrMap classes;
+
+    // PyTypeObject* -> Binding* declared with register_class, also
+    // holding a reference to the type.
+    PtrMap bindings;
 } Runtime;
 
 extern PyTypeObject _RuntimeType;
 
+int64_t Runtime_now_ms(void);
+int Runtime_set_deadline(Runtime* rt, struct Context* cx, int64_t deadline);
+void Runtime_add_context(Runtime* rt, struct Context* cx);
+void Runtime_remove_context(Runtime* rt, struct Context* cx);
+
 #endif
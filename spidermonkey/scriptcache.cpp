@@ -0,0 +1,183 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#include "spidermonkey.h"
+
+static void
+unlink_entry(ScriptCache* cache, ScriptCacheEntry* entry)
+{
+    if(entry->prev != NULL) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+
+    if(entry->next != NULL) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+static void
+push_front(ScriptCache* cache, ScriptCacheEntry* entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if(cache->head != NULL) cache->head->prev = entry;
+    cache->head = entry;
+    if(cache->tail == NULL) cache->tail = entry;
+}
+
+static void
+drop_entry(ScriptCache* cache, JSRuntime* rt, ScriptCacheEntry* entry)
+{
+    unlink_entry(cache, entry);
+    if(cache->index != NULL && PyDict_DelItem(cache->index, entry->key) < 0)
+    {
+        PyErr_Clear();
+    }
+    JS_RemoveScriptRootRT(rt, &(entry->script));
+    Py_DECREF(entry->key);
+    free(entry);
+    cache->count--;
+}
+
+static void
+evict(ScriptCache* cache, JSRuntime* rt)
+{
+    while(cache->count > cache->size && cache->tail != NULL)
+    {
+        drop_entry(cache, rt, cache->tail);
+        cache->evictions++;
+    }
+}
+
+JSScript*
+ScriptCache_lookup(ScriptCache* cache, Context* cx, PyObject* code,
+                    const char* fname, unsigned int lineno)
+{
+    ScriptCacheEntry* entry = NULL;
+    JSRuntime* rt = cx->rt->rt;
+    JSString* source = NULL;
+    const jschar* schars = NULL;
+    size_t slen;
+    PyObject* found = NULL;
+    PyObject* ptr = NULL;
+
+    CPyAutoObject key(Py_BuildValue("(OsI)", code, fname, lineno));
+    if(key.isNull()) return NULL;
+
+    if(cache->index == NULL)
+    {
+        cache->index = PyDict_New();
+        if(cache->index == NULL) return NULL;
+    }
+
+    // PyDict_GetItem swallows hashing errors, so hash up front.
+    if(PyObject_Hash(key) == -1) return NULL;
+    found = PyDict_GetItem(cache->index, key);
+
+    if(found != NULL)
+    {
+        entry = (ScriptCacheEntry*) PyLong_AsVoidPtr(found);
+        unlink_entry(cache, entry);
+        push_front(cache, entry);
+        cache->hits++;
+        return entry->script;
+    }
+
+    cache->misses++;
+
+    source = py2js_string_obj(cx, code);
+    if(source == NULL) return NULL;
+
+    schars = JS_GetStringCharsZ(cx->cx, source);
+    if(schars == NULL) return NULL;
+    slen = JS_GetStringLength(source);
+
+    entry = (ScriptCacheEntry*) malloc(sizeof(ScriptCacheEntry));
+    if(entry == NULL)
+    {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    entry->prev = entry->next = NULL;
+
+    entry->script = JS_CompileUCScript(cx->cx, cx->root, schars, slen, fname, lineno);
+    if(entry->script == NULL)
+    {
+        free(entry);
+        if(!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Script could not be compiled");
+        }
+        return NULL;
+    }
+
+    if(!JS_AddNamedScriptRootRT(rt, &(entry->script), "ScriptCache_lookup"))
+    {
+        free(entry);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to root cached script.");
+        return NULL;
+    }
+
+    ptr = PyLong_FromVoidPtr(entry);
+    if(ptr == NULL || PyDict_SetItem(cache->index, key, ptr) < 0)
+    {
+        Py_XDECREF(ptr);
+        JS_RemoveScriptRootRT(rt, &(entry->script));
+        free(entry);
+        return NULL;
+    }
+    Py_DECREF(ptr);
+
+    entry->key = Py_INCREF_RET((PyObject*) key);
+    push_front(cache, entry);
+    cache->count++;
+
+    // The new entry is at the head, so it survives unless size is 0.
+    evict(cache, rt);
+
+    return entry->script;
+}
+
+int
+ScriptCache_resize(ScriptCache* cache, JSRuntime* rt, Py_ssize_t size)
+{
+    if(size < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Script cache size must not be negative.");
+        return 0;
+    }
+
+    cache->size = size;
+    evict(cache, rt);
+
+    if(size == 0) Py_CLEAR(cache->index);
+
+    return 1;
+}
+
+void
+ScriptCache_clear(ScriptCache* cache, JSRuntime* rt)
+{
+    while(cache->head != NULL)
+    {
+        drop_entry(cache, rt, cache->head);
+    }
+    Py_CLEAR(cache->index);
+}
+
+PyObject*
+ScriptCache_stats(ScriptCache* cache)
+{
+    return Py_BuildValue("{s:n,s:n,s:k,s:k,s:k}",
+        "size", cache->size,
+        "entries", cache->count,
+        "hits", cache->hits,
+        "misses", cache->misses,
+        "evictions", cache->evictions
+    );
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+ *
+ * This file is part of the python-spidermonkey package released
+ * under the MIT license.
+ *
+ */
+
+#ifndef PYSM_SCRIPTCACHE_H
+#define PYSM_SCRIPTCACHE_H
+
+/*
+    A per-Runtime LRU of compiled scripts used by Context.execute.
+
+    Entries are found through a Python dict keyed by the tuple
+    (source, filename, lineno), so the source hash is the one Python
+    caches on the string object. The dict maps to entries on a doubly
+    linked list, most recently used first. Each entry keeps its script
+    rooted until it is evicted.
+*/
+
+typedef struct ScriptCacheEntry {
+    JSScript* script;
+    PyObject* key;
+    struct ScriptCacheEntry* prev;
+    struct ScriptCacheEntry* next;
+} ScriptCacheEntry;
+
+typedef struct {
+    PyObject* index;            // key -> PyLong(ScriptCacheEntry*)
+    ScriptCacheEntry* head;
+    ScriptCacheEntry* tail;
+    Py_ssize_t size;            // 0 means the cache is disabled
+    Py_ssize_t count;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} ScriptCache;
+
+struct Context;
+
+/*
+    Returns a borrowed script, compiling it on a miss. The script is
+    rooted by the cache, but may be evicted by the next lookup.
+*/
+JSScript* ScriptCache_lookup(ScriptCache* cache, struct Context* cx, PyObject* code,
+                                const char* fname, unsigned int lineno);
+int ScriptCache_resize(ScriptCache* cache, JSRuntime* rt, Py_ssize_t size);
+void ScriptCache_clear(ScriptCache* cache, JSRuntime* rt);
+PyObject* ScriptCache_stats(ScriptCache* cache);
+
+#endif
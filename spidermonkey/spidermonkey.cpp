@@ -21,9 +21,19 @@ PyTypeObject* FunctionType = NULL;
 PyTypeObject* CompiledType = NULL;
 PyTypeObject* IteratorType = NULL;
 PyTypeObject* HashCObjType = NULL;
+PyTypeObject* FutureType = NULL;
+PyTypeObject* PoolType = NULL;
+PyTypeObject* ContextPoolType = NULL;
 PyObject* JSError = NULL;
+PyObject* JSInterrupted = NULL;
 
 static PyMethodDef spidermonkey_methods[] = {
+    {
+        "alloc_stats",
+        (PyCFunction)FreeList_stats,
+        METH_NOARGS,
+        "Return allocation counters for the wrapper types."
+    },
     {NULL}
 };
 
@@ -31,6 +41,9 @@ PyMODINIT_FUNC
 initspidermonkey(void)
 {
     PyObject* m;
+
+    // JavaScript executes with the GIL released.
+    PyEval_InitThreads();
     
     if(PyType_Ready(&_RuntimeType) < 0) return;
     if(PyType_Ready(&_ContextType) < 0) return;
@@ -46,6 +59,10 @@ initspidermonkey(void)
     if(PyType_Ready(&_IteratorType) < 0) return;
 
     if(PyType_Ready(&_HashCObjType) < 0) return;
+
+    if(PyType_Ready(&_FutureType) < 0) return;
+    if(PyType_Ready(&_PoolType) < 0) return;
+    if(PyType_Ready(&_ContextPoolType) < 0) return;
     
     m = Py_InitModule3("spidermonkey", spidermonkey_methods,
             "The Python-Spidermonkey bridge.");
@@ -87,8 +104,23 @@ initspidermonkey(void)
     Py_INCREF(HashCObjType);
     // Don't add access from the module on purpose.
 
+    FutureType = &_FutureType;
+    Py_INCREF(FutureType);
+    PyModule_AddObject(m, "Future", (PyObject*) FutureType);
+
+    PoolType = &_PoolType;
+    Py_INCREF(PoolType);
+    PyModule_AddObject(m, "Pool", (PyObject*) PoolType);
+
+    ContextPoolType = &_ContextPoolType;
+    Py_INCREF(ContextPoolType);
+    PyModule_AddObject(m, "ContextPool", (PyObject*) ContextPoolType);
+
     JSError = PyErr_NewException((char*)"spidermonkey.JSError", NULL, NULL);
     PyModule_AddObject(m, "JSError", JSError);
+
+    JSInterrupted = PyErr_NewException((char*)"spidermonkey.Interrupted", NULL, NULL);
+    PyModule_AddObject(m, "Interrupted", JSInterrupted);
     
     SpidermonkeyModule = m;
 }
@@ -17,10 +17,16 @@
 #pragma GCC diagnostic ignored "-Winvalid-offsetof"
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #include <jsapi.h>
+#include <jsfriendapi.h>
 #pragma GCC diagnostic warning "-Winvalid-offsetof"
 #pragma GCC diagnostic warning "-Wunused-variable"
 
 #include "pyplus.h"
+#include "ptrmap.h"
+#include "handles.h"
+#include "rootarena.h"
+#include "access.h"
+#include "keycache.h"
 
 #include "runtime.h"
 #include "context.h"
@@ -31,6 +37,9 @@
 
 #include "pyobject.h"
 #include "pyiter.h"
+#include "pymember.h"
+#include "pycontainer.h"
+#include "bindings.h"
 
 #include "jsobject.h"
 #include "jsarray.h"
@@ -39,9 +48,15 @@
 #include "jsiterator.h"
 
 #include "convert.h"
+#include "deepconv.h"
 #include "error.h"
 
 #include "hashcobj.h"
+#include "freelist.h"
+
+#include "future.h"
+#include "pool.h"
+#include "ctxpool.h"
 
 extern PyObject* SpidermonkeyModule;
 extern PyTypeObject* RuntimeType;
@@ -53,7 +68,11 @@ extern PyTypeObject* CompiledType;
 extern PyTypeObject* FunctionType;
 extern PyTypeObject* IteratorType;
 extern PyTypeObject* HashCObjType;
+extern PyTypeObject* FutureType;
+extern PyTypeObject* PoolType;
+extern PyTypeObject* ContextPoolType;
 extern PyObject* JSError;
+extern PyObject* JSInterrupted;
 
 #endif
 
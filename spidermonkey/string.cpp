@@ -8,17 +8,91 @@
 
 #include "spidermonkey.h"
 
+static int
+is_ascii(const char* bytes, Py_ssize_t len)
+{
+    unsigned char acc = 0;
+    Py_ssize_t i;
+
+    // No early exit so the compiler can vectorize the scan.
+    for(i = 0; i < len; i++) acc |= (unsigned char) bytes[i];
+
+    return acc < 0x80;
+}
+
+#if Py_UNICODE_SIZE == 4
+/*
+    Narrow UCS-4 to UTF-16. The plain loop is the common case and
+    vectorizes; characters outside the BMP need surrogate pairs.
+*/
+static JSString*
+ucs4_to_js(Context* cx, const Py_UNICODE* src, Py_ssize_t len)
+{
+    JSString* ret = NULL;
+    jschar* buf = NULL;
+    Py_ssize_t extra = 0;
+    Py_ssize_t i;
+    Py_ssize_t j;
+
+    for(i = 0; i < len; i++) extra += (src[i] > 0xFFFF);
+
+    buf = (jschar*) JS_malloc(cx->cx, (len + extra + 1) * sizeof(jschar));
+    if(buf == NULL)
+    {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    if(extra == 0)
+    {
+        for(i = 0; i < len; i++) buf[i] = (jschar) src[i];
+    }
+    else
+    {
+        for(i = 0, j = 0; i < len; i++)
+        {
+            Py_UNICODE c = src[i];
+            if(c > 0xFFFF)
+            {
+                c -= 0x10000;
+                buf[j++] = (jschar) (0xD800 | (c >> 10));
+                buf[j++] = (jschar) (0xDC00 | (c & 0x3FF));
+            }
+            else
+            {
+                buf[j++] = (jschar) c;
+            }
+        }
+    }
+    buf[len + extra] = 0;
+
+    // On success the string owns buf.
+    ret = JS_NewUCString(cx->cx, buf, len + extra);
+    if(ret == NULL)
+    {
+        JS_free(cx->cx, buf);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create JS string.");
+    }
+
+    return ret;
+}
+#endif
+
 JSString*
 py2js_string_obj(Context* cx, PyObject* str)
 {
     PyObject* conv = NULL;
-    PyObject* encoded = NULL;
     JSString* ret = NULL;
-    char* bytes;
-    Py_ssize_t len;
 
     if(PyString_Check(str))
     {
+        // ASCII is valid UTF-8 and widens byte for byte.
+        if(is_ascii(PyString_AS_STRING(str), PyString_GET_SIZE(str)))
+        {
+            ret = JS_NewStringCopyN(cx->cx, PyString_AS_STRING(str), PyString_GET_SIZE(str));
+            goto done;
+        }
+
         conv = PyUnicode_FromEncodedObject(str, "utf-8", "replace");
         if(conv == NULL) goto error;
         str = conv;
@@ -29,29 +103,22 @@ py2js_string_obj(Context* cx, PyObject* str)
         goto error;
     }
 
-    encoded = PyUnicode_AsEncodedString(str, "utf-16", "strict");
-    if(encoded == NULL) goto error;
-    if(PyString_AsStringAndSize(encoded, &bytes, &len) < 0) goto error;
-    if(len < 2)
-    {
-        PyErr_SetString(PyExc_ValueError, "Failed to find byte-order mark.");
-        goto error;
-    }
+#if Py_UNICODE_SIZE == 2
+    ret = JS_NewUCStringCopyN(cx->cx, (const jschar*) PyUnicode_AS_UNICODE(str),
+                                PyUnicode_GET_SIZE(str));
+#else
+    ret = ucs4_to_js(cx, PyUnicode_AS_UNICODE(str), PyUnicode_GET_SIZE(str));
+    if(ret == NULL) goto error;
+#endif
 
-    if(((unsigned short*) bytes)[0] != 0xFEFF)
+done:
+    if(ret == NULL && !PyErr_Occurred())
     {
-        PyErr_SetString(PyExc_ValueError, "Invalid UTF-16 BOM");
-        goto error;
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create JS string.");
     }
 
-    ret = JS_NewUCStringCopyN(cx->cx, (jschar*) (bytes+2), (len/2)-1);
-    
-    goto success;
-
 error:
-success:
     Py_XDECREF(conv);
-    Py_XDECREF(encoded);
     return ret;
 }
 
@@ -68,22 +135,66 @@ py2js_string(Context* cx, PyObject* str)
     return STRING_TO_JSVAL(val);
 }
 
+/*
+    JS strings are UTF-16. Without surrogates every jschar is exactly
+    one Py_UNICODE, so the buffer is widened (or copied on UCS-2
+    builds) straight into a new unicode object. Only strings with
+    surrogate pairs go through the codec.
+*/
 PyObject*
-js2py_string(Context* cx, jsval val)
+js2py_string_obj(Context* cx, JSString* str)
 {
-    JSString* str;
-    const jschar* bytes;
-    size_t len;
+    PyObject* ret = NULL;
+    Py_UNICODE* dst = NULL;
+    const jschar* src = NULL;
+    size_t len = 0;
+
+    // Doesn't need a terminator, so dependent strings aren't copied.
+    src = JS_GetStringCharsAndLength(cx->cx, str, &len);
+    if(src == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to read JS string.");
+        return NULL;
+    }
+
+#if Py_UNICODE_SIZE == 4
+    {
+        jschar surrogates = 0;
+        size_t i;
 
+        // No early exit so the compiler can vectorize the scan.
+        for(i = 0; i < len; i++) surrogates |= ((src[i] & 0xF800) == 0xD800);
+
+        if(surrogates)
+        {
+            return PyUnicode_Decode((const char*) src, len*2, "utf-16", "strict");
+        }
+
+        ret = PyUnicode_FromUnicode(NULL, len);
+        if(ret == NULL) return NULL;
+
+        dst = PyUnicode_AS_UNICODE(ret);
+        for(i = 0; i < len; i++) dst[i] = src[i];
+    }
+#else
+    ret = PyUnicode_FromUnicode(NULL, len);
+    if(ret == NULL) return NULL;
+
+    dst = PyUnicode_AS_UNICODE(ret);
+    memcpy(dst, src, len * sizeof(jschar));
+#endif
+
+    return ret;
+}
+
+PyObject*
+js2py_string(Context* cx, jsval val)
+{
     if(!JSVAL_IS_STRING(val))
     {
         PyErr_SetString(PyExc_TypeError, "Value is not a JS String.");
         return NULL;
     }
 
-    str = JSVAL_TO_STRING(val);
-    len = JS_GetStringLength(str);
-    bytes = JS_GetStringCharsZ(cx->cx, str);
-
-    return PyUnicode_Decode((const char*) bytes, len*2, "utf-16", "strict");
+    return js2py_string_obj(cx, JSVAL_TO_STRING(val));
 }
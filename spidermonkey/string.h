@@ -12,5 +12,6 @@
 JSString* py2js_string_obj(Context* cx, PyObject* str);
 jsval py2js_string(Context* cx, PyObject* str);
 PyObject* js2py_string(Context* cx, jsval val);
+PyObject* js2py_string_obj(Context* cx, JSString* str);
 
 #endif
@@ -0,0 +1,52 @@
+# Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+#
+# This file is part of the python-spidermonkey package released
+# under the MIT license.
+"""\
+Time string conversion across the bridge in both directions.
+
+Not collected by nose. Run it directly against a build:
+
+    python tests/bench-strings.py
+
+The codec columns time the UTF-16 encode and decode the bridge used to
+run on every string, on the same inputs, as a baseline for the direct
+copies that replaced them.
+"""
+import timeit
+
+import spidermonkey
+
+CASES = [
+    ("short ascii key", "some_key", 200000),
+    ("short latin-1", u"caf\xe9 cr\xe8me", 200000),
+    ("2MB ascii", "x" * (2 << 20), 50),
+    ("2MB bmp", u"\u4e2d" * (2 << 20), 50),
+    ("2MB astral", u"\U0001F600" * (1 << 20), 20),
+]
+
+def main():
+    rt = spidermonkey.Runtime()
+    cx = rt.new_context()
+    echo = cx.execute("(function(s) {return s;})")
+    length = cx.execute("(function(s) {return s.length;})")
+
+    print "%-18s %14s %14s %14s %14s" % ("case", "py->js us/op",
+        "round us/op", "encode us/op", "decode us/op")
+    for name, value, number in CASES:
+        to_js = timeit.Timer(lambda: length(value)).timeit(number)
+        round_trip = timeit.Timer(lambda: echo(value)).timeit(number)
+
+        # The old py2js_string encoded with a BOM and copied past it; the
+        # old js2py_string decoded the BOM-less native order buffer.
+        text = unicode(value)
+        chars = text.encode("utf-16")[2:]
+        encode = timeit.Timer(lambda: text.encode("utf-16")).timeit(number)
+        decode = timeit.Timer(lambda: chars.decode("utf-16")).timeit(number)
+
+        print "%-18s %14.2f %14.2f %14.2f %14.2f" % (name,
+            to_js * 1e6 / number, round_trip * 1e6 / number,
+            encode * 1e6 / number, decode * 1e6 / number)
+
+if __name__ == "__main__":
+    main()
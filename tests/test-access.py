@@ -123,3 +123,57 @@ def test_obj_method(cx):
     t.eq(cx.execute('bing["bing"]'), 3)
     t.raises(t.JSError, cx.execute, 'bing["kablooie"]')
     t.eq(c.names, ["bing", "kablooie"])
+
+@t.cx()
+def test_access_policy(cx):
+    class Vault(object):
+        def __init__(self):
+            self.gold = 10
+            self._key = "secret"
+            self.log = "hidden"
+    calls = []
+    def check(obj, name):
+        calls.append(name)
+        return name != "log"
+    cx.add_global("v", Vault())
+    cx.set_access(check)
+    cx.set_access_policy({Vault: {"deny": ["_*"], "allow": ["gold"]}})
+    t.eq(cx.execute("v.gold;"), 10)
+    t.raises(t.JSError, cx.execute, "v._key;")
+    t.raises(t.JSError, cx.execute, "v.log;")
+    t.eq(calls, [])
+
+@t.cx()
+def test_access_policy_defers(cx):
+    class Box(object):
+        def __init__(self):
+            self.a = 1
+            self.b = 2
+    def check(obj, name):
+        return name != "b"
+    cx.add_global("box", Box())
+    cx.set_access(check)
+    cx.set_access_policy({None: {"deny": ["_*"]}})
+    t.eq(cx.execute("box.a;"), 1)
+    t.raises(t.JSError, cx.execute, "box.b;")
+    t.raises(t.JSError, cx.execute, "box.__class__;")
+
+@t.cx()
+def test_access_policy_call(cx):
+    def f():
+        return 1
+    cx.add_global("f", f)
+    cx.set_access_policy({type(f): {"call": False}})
+    t.raises(t.JSError, cx.execute, "f();")
+    cx.set_access_policy(None)
+    t.eq(cx.execute("f();"), 1)
+
+@t.rt()
+def test_access_policy_delete(rt):
+    glbl = {"open": 1, "_secret": 2}
+    cx = rt.new_context(glbl)
+    cx.set_access_policy({None: {"deny": ["_*"]}})
+    cx.execute("delete open;")
+    t.eq("open" in glbl, False)
+    t.raises(t.JSError, cx.execute, "delete _secret;")
+    t.eq(glbl["_secret"], 2)
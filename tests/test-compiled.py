@@ -2,6 +2,9 @@
 #
 # This file is part of the python-spidermonkey package released
 # under the MIT license.
+import os
+import shutil
+import tempfile
 import t
 import time
 
@@ -29,3 +32,52 @@ def test_compiled_contexts(rt):
     expr1 = ctx1.compile("a * 3;")
     t.eq(expr1.execute(), 333)
     t.eq(expr1.execute(ctx2), 666)
+
+@t.rt()
+def test_dumps_loads(rt):
+    cx1 = rt.new_context({'a': 2})
+    data = cx1.compile("a * 21;").dumps()
+    t.eq(isinstance(data, str), True)
+    cx2 = rt.new_context({'a': 3})
+    t.eq(cx2.loads(data).execute(), 63)
+
+@t.cx()
+def test_loads_garbage(cx):
+    t.raises(t.JSError, cx.loads, "not bytecode")
+    data = cx.compile("[1, 2, 3].length;").dumps()
+    t.raises(t.JSError, cx.loads, data[:-1])
+    t.raises(t.JSError, cx.loads, data[:-1] + chr(ord(data[-1]) ^ 1))
+    t.eq(cx.loads(data).execute(), 3)
+
+@t.rt()
+def test_cache_dir(rt):
+    path = tempfile.mkdtemp()
+    try:
+        t.eq(rt.cache_dir(path), None)
+        t.eq(rt.cache_dir(), path)
+        cx = rt.new_context()
+        t.eq(cx.compile("6 * 7;").execute(), 42)
+        entries = os.listdir(path)
+        t.eq(len(entries), 1)
+        t.eq(entries[0].endswith(".jsc"), True)
+        t.eq(cx.compile("6 * 7;").execute(), 42)
+        t.eq(os.listdir(path), entries)
+        t.eq(rt.cache_dir(None), path)
+    finally:
+        shutil.rmtree(path)
+
+@t.rt()
+def test_cache_dir_corrupt(rt):
+    path = tempfile.mkdtemp()
+    try:
+        rt.cache_dir(path)
+        cx = rt.new_context()
+        t.eq(cx.compile("6 * 7;").execute(), 42)
+        entry = os.path.join(path, os.listdir(path)[0])
+        data = open(entry, "rb").read()
+        for junk in (data[:len(data) // 2], "garbage" * 10):
+            open(entry, "wb").write(junk)
+            t.eq(cx.compile("6 * 7;").execute(), 42)
+        t.eq(open(entry, "rb").read(), data)
+    finally:
+        shutil.rmtree(path)
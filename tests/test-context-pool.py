@@ -0,0 +1,92 @@
+# Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+#
+# This file is part of the python-spidermonkey package released
+# under the MIT license.
+import t
+
+@t.rt()
+def test_bootstrapped(rt):
+    pool = rt.context_pool(2, bootstrap="var lib = {answer: 42};")
+    t.eq(pool.size, 2)
+    t.eq(pool.idle, 2)
+    cx = pool.acquire()
+    t.eq(pool.leased, 1)
+    t.eq(cx.execute("lib.answer;"), 42)
+    pool.release(cx)
+    t.eq(pool.idle, 2)
+    t.eq(pool.leased, 0)
+
+@t.rt()
+def test_compiled_bootstrap(rt):
+    boot = rt.new_context().compile("var base = 10;")
+    pool = rt.context_pool(1, bootstrap=boot)
+    cx = pool.acquire()
+    t.eq(cx.execute("base * 2;"), 20)
+    pool.release(cx)
+
+@t.rt()
+def test_reset(rt):
+    pool = rt.context_pool(1, bootstrap="var count = 1;")
+    cx = pool.acquire()
+    cx.execute("count = 5; leaked = true; var declared = 3;")
+    pool.release(cx)
+    cx = pool.acquire()
+    t.eq(cx.execute("count;"), 1)
+    t.eq(cx.execute("typeof leaked;"), "undefined")
+    t.eq(cx.execute("typeof declared;"), "undefined")
+    t.eq(cx.execute("typeof Math.max;"), "function")
+    pool.release(cx)
+
+@t.rt()
+def test_reset_hidden(rt):
+    pool = rt.context_pool(1)
+    cx = pool.acquire()
+    cx.execute("Math = 0; JSON = null;")
+    cx.execute("Object.defineProperty(this, 'hidden', {value: 1});")
+    t.eq(cx.execute("hidden;"), 1)
+    pool.release(cx)
+    cx = pool.acquire()
+    t.eq(cx.execute("typeof Math.max;"), "function")
+    t.eq(cx.execute("JSON.stringify([1]);"), "[1]")
+    t.eq(cx.execute("typeof hidden;"), "undefined")
+    t.eq(cx.execute("Object.keys(this).indexOf('Math');"), -1)
+    pool.release(cx)
+
+@t.rt()
+def test_reset_settings(rt):
+    pool = rt.context_pool(1, glbl={"x": 1})
+    cx = pool.acquire()
+    cx.set_access(lambda obj, name: False)
+    cx.set_access_policy({None: {"deny": ["x"]}})
+    cx.max_time(5)
+    t.raises(t.JSError, cx.execute, "x;")
+    pool.release(cx)
+    cx = pool.acquire()
+    t.eq(cx.execute("x;"), 1)
+    t.eq(cx.max_time(), 0)
+    pool.release(cx)
+
+@t.rt()
+def test_exhausted(rt):
+    pool = rt.context_pool(1)
+    cx1 = pool.acquire()
+    cx2 = pool.acquire()
+    t.ne(cx1, cx2)
+    pool.release(cx1)
+    pool.release(cx2)
+    t.eq(pool.idle, 1)
+
+@t.rt()
+def test_foreign_context(rt):
+    pool = rt.context_pool(1)
+    t.raises(ValueError, pool.release, rt.new_context())
+
+@t.rt()
+def test_python_global_untouched(rt):
+    glbl = {"x": 1}
+    pool = rt.context_pool(1, glbl=glbl)
+    cx = pool.acquire()
+    cx.execute("x = 2; y = 3;")
+    t.eq(glbl, {"x": 2, "y": 3})
+    pool.release(cx)
+    t.eq(glbl, {"x": 2, "y": 3})
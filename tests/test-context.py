@@ -3,6 +3,7 @@
 # This file is part of the python-spidermonkey package released
 # under the MIT license.
 import t
+import threading
 import time
 
 @t.rt()
@@ -43,7 +44,6 @@ def test_get_set_limits(cx):
 
 @t.cx()
 def test_exceed_time(cx):
-    return
     script = """
         var time = function() {return (new Date()).getTime();};
         var start = time();
@@ -52,6 +52,39 @@ def test_exceed_time(cx):
     cx.max_time(1)
     t.raises(SystemError, cx.execute, script)
 
+@t.cx()
+def test_timeout_ms(cx):
+    start = time.time()
+    t.raises(SystemError, cx.execute, "while(true) {}", timeout_ms=50)
+    t.lt(time.time() - start, 1)
+    t.eq(cx.execute("1 + 1;", timeout_ms=50), 2)
+
+@t.cx()
+def test_timeout_ms_compiled(cx):
+    loop = cx.compile("while(true) {}")
+    t.raises(SystemError, loop.execute, timeout_ms=50)
+
+@t.cx()
+def test_timeout_ms_function(cx):
+    func = cx.execute("(function(a) {while(a) {}; return 3;})")
+    t.raises(SystemError, func, True, timeout_ms=50)
+    t.eq(func(False, timeout_ms=50), 3)
+
+@t.cx()
+def test_interrupt(cx):
+    timer = threading.Timer(0.05, cx.interrupt)
+    timer.start()
+    start = time.time()
+    t.raises(t.spidermonkey.Interrupted, cx.execute, "while(true) {}")
+    t.lt(time.time() - start, 1)
+    timer.join()
+    t.eq(cx.execute("1 + 1;"), 2)
+
+@t.cx()
+def test_interrupt_idle(cx):
+    t.eq(cx.interrupt(), False)
+    t.eq(cx.execute("1 + 1;"), 2)
+
 @t.cx()
 def test_does_not_exceed_time(cx):
     return
@@ -84,3 +117,53 @@ def test_does_not_exceed_memory(cx):
     script = "var f = 2; f;"
     cx.execute(script)
 
+
+@t.cx()
+def test_handles_released(cx):
+    class Item(object):
+        pass
+    keep = Item()
+    cx.add_global("keep", keep)
+    func = cx.execute("(function(o) {return 1;})")
+    for i in range(1000):
+        func(Item())
+    cx.gc()
+    stats = cx.handle_stats()
+    t.lt(stats["live"], 10)
+    t.eq(cx.execute("keep;") is keep, True)
+
+@t.cx()
+def test_wrapper_roots(cx):
+    base = cx.handle_stats()["roots"]
+    objs = [cx.execute("({a: %d})" % i) for i in range(600)]
+    t.eq(cx.handle_stats()["roots"], base + 600)
+    cx.gc()
+    t.eq([o.a for o in objs], range(600))
+    del objs
+    t.eq(cx.handle_stats()["roots"], base)
+
+@t.cx()
+def test_key_cache(cx):
+    obj = cx.execute('({"alpha": 1, "beta": 2});')
+    t.eq(obj.alpha + obj["beta"], 3)
+    before = cx.key_cache_stats()
+    for i in range(10):
+        t.eq(obj.alpha, 1)
+    after = cx.key_cache_stats()
+    t.eq(after["hits"] - before["hits"], 10)
+    cx.gc()
+    t.eq(obj.alpha, 1)
+
+@t.cx()
+def test_to_js(cx):
+    shared = [1, 2]
+    data = {"a": shared, "b": (shared, "x"), 3: None}
+    data["self"] = data
+    obj = cx.to_js(data)
+    cx.add_global("obj", obj)
+    t.eq(cx.execute("obj.a === obj.b[0] && obj.self === obj;"), True)
+    t.eq(cx.execute("Array.isArray(obj.b) && obj[3] === null;"), True)
+    data["a"].append(3)
+    t.eq(cx.execute("obj.a.length;"), 2)
+    t.raises(ValueError, cx.to_js, [[[]]], max_depth=2)
+    t.raises(TypeError, cx.to_js, {(1, 2): 3})
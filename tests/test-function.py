@@ -82,3 +82,41 @@ def test_bound_method_in_thread():
     f.t.join()
             
             
+
+@t.cx()
+def test_python_function_is_js_function(cx):
+    def add(a, b=10):
+        return a + b
+    cx.add_global("add", add)
+    t.eq(cx.execute("add instanceof Function;"), True)
+    t.eq(cx.execute("add.length;"), 2)
+    t.eq(cx.execute("add.call(null, 1, 2);"), 3)
+    t.eq(cx.execute("add.apply(null, [5]);"), 15)
+    t.eq(cx.execute("add;") is add, True)
+
+    class Scale(object):
+        def by(self, a, b=2):
+            return a * b
+    cx.add_global("by", Scale().by)
+    t.eq(cx.execute("by instanceof Function;"), True)
+    t.eq(cx.execute("by.length;"), 2)
+    t.eq(cx.execute("by.call(null, 3);"), 6)
+
+@t.cx()
+def test_builtin_fast_paths(cx):
+    cx.add_global("items", [3, 1, 2])
+    cx.add_global("length", len)
+    cx.add_global("pop", [1, 2].pop)
+    t.eq(cx.execute("length('abcd');"), 4)
+    t.eq(cx.execute("pop();"), 2)
+    t.raises(t.JSError, cx.execute, "length();")
+
+@t.cx()
+def test_deep_arguments(cx):
+    func = cx.execute("function(d) {return Array.isArray(d.items) && d.items[1];}")
+    data = {"items": [1, 2]}
+    t.eq(func(data, deep=True), 2)
+    t.eq(func(data, deep=True, timeout_ms=50), 2)
+    t.eq(func(data), False)
+    t.raises(ValueError, func, {"a": {"b": {}}}, deep=2)
+    t.raises(TypeError, func, data, bogus=True)
@@ -140,3 +140,48 @@ def test_py_with_active_global(rt):
     cx.execute("foo = 4;")
     t.eq(cx.execute("foo;"), 8)
     t.eq(glbl.data["foo"], 8);
+
+@t.rt()
+def test_materialized_global(rt):
+    glbl = {"n": 2, "f": lambda x: x + 1}
+    cx = rt.new_context(glbl, materialize=True)
+    t.eq(cx.execute("var s = 0; for(var i = 0; i < 10; i++) s += n; s;"), 20)
+    t.eq(cx.execute("f(n);"), 3)
+    cx.execute("n = 5; m = 7;")
+    t.eq(glbl["n"], 5)
+    t.eq(glbl["m"], 7)
+    glbl["n"] = 9
+    t.eq(cx.execute("n;"), 5)
+    t.eq(cx.invalidate("n"), 1)
+    t.eq(cx.execute("n;"), 9)
+    glbl["m"] = 1
+    t.gt(cx.invalidate(), 0)
+    t.eq(cx.execute("m;"), 1)
+    cx.execute("delete n;")
+    t.eq("n" in glbl, False)
+    cx.execute("var v = 1;")
+    t.eq(glbl["v"], 1)
+    glbl["v"] = 2
+    t.eq(cx.invalidate("v"), 1)
+    t.eq(cx.execute("v;"), 2)
+    glbl["v"] = 3
+    t.gt(cx.invalidate(), 0)
+    t.eq(cx.execute("v;"), 3)
+
+@t.rt()
+def test_missing_global_cached(rt):
+    glbl = {"a": 1}
+    checked = []
+    def check(obj, name):
+        checked.append(name)
+        return True
+    cx = rt.new_context(glbl, check)
+    probe = "(function() {for(var i = 0; i < 5; i++) typeof absent;})();"
+    cx.execute(probe)
+    t.eq(checked.count("absent"), 1)
+    glbl["absent"] = 2
+    t.eq(cx.execute("absent;"), 2)
+    t.eq(cx.execute("typeof b;"), "undefined")
+    del glbl["a"]
+    glbl["b"] = 3
+    t.eq(cx.execute("b;"), 3)
@@ -76,3 +76,219 @@ def test_nested_object_equality(cx):
         cx.execute('["foo", 2, {"bar": 2.3, "spam": [1,2,3]}];'),
         [u"foo", 2, {u"bar": 2.3, u"spam": [1,2,3]}]
     )
+
+@t.cx()
+def test_wrapper_identity(cx):
+    cx.execute("var outer = {inner: {x: 1}, list: [1, 2]};")
+    outer = cx.execute("outer;")
+    t.eq(outer.inner is outer.inner, True)
+    t.eq(outer.list is outer.list, True)
+    t.eq(cx.execute("outer;") is outer, True)
+
+@t.cx()
+def test_method_wrapper_keeps_this(cx):
+    obj = cx.execute("var o = {v: 3, get: function() {return this.v;}}; o;")
+    t.eq(obj.get is obj.get, True)
+    bare = cx.execute("o.get;")
+    t.eq(bare is obj.get, False)
+    t.eq(obj.get(), 3)
+
+@t.cx()
+def test_python_object_identity(cx):
+    class Config(object):
+        pass
+    cfg = Config()
+    same = cx.execute("(function(a, b) {return a === b;})")
+    t.eq(same(cfg, cfg), True)
+    cx.add_global("cfg", cfg)
+    t.eq(cx.execute("cfg;") is cfg, True)
+    t.eq(same(cfg, Config()), False)
+
+@t.cx()
+def test_wrapper_free_list(cx):
+    def stats():
+        return t.spidermonkey.alloc_stats()["spidermonkey.Object"]
+    for i in range(10):
+        cx.execute("({})")
+    before = stats()
+    for i in range(10):
+        cx.execute("({})")
+    after = stats()
+    t.eq(after["allocs"] - before["allocs"], 10)
+    t.eq(after["reuses"] - before["reuses"], 10)
+
+@t.cx()
+def test_python_methods_on_prototype(cx):
+    class Counter(object):
+        def __init__(self):
+            self.n = 0
+        def incr(self, by):
+            self.n += by
+            return self.n
+    cx.add_global("a", Counter())
+    cx.add_global("b", Counter())
+    t.eq(cx.execute("a.incr(2); a.incr(3);"), 5)
+    t.eq(cx.execute("b.incr(1);"), 1)
+    t.eq(cx.execute("a.incr === b.incr;"), True)
+    t.eq(cx.execute("a.hasOwnProperty('incr');"), False)
+
+@t.cx()
+def test_shadowed_python_methods(cx):
+    class Base(object):
+        def foo(self):
+            return "base"
+        def bar(self):
+            return "bar"
+    class Child(Base):
+        foo = 5
+    c = Child()
+    c.bar = "instance"
+    cx.add_global("c", c)
+    t.eq(cx.execute("c.foo;"), 5)
+    t.eq(cx.execute("c.bar;"), "instance")
+    del c.bar
+    t.eq(cx.execute("c.bar();"), "bar")
+
+@t.cx()
+def test_detached_python_method(cx):
+    class Doubler(object):
+        def double(self, x, *rest):
+            return x * 2
+    cx.add_global("d", Doubler())
+    t.raises(t.JSError, cx.execute, "var f = d.double; f(1);")
+    t.raises(t.JSError, cx.execute, "[1, 2].map(d.double);")
+    t.eq(cx.execute("[1, 2].map(d.double.bind(d))[1];"), 4)
+
+@t.cx()
+def test_same_type_name(cx):
+    def make(val):
+        class Thing(object):
+            def get(self):
+                return val
+        return Thing()
+    cx.add_global("one", make(1))
+    cx.add_global("two", make(2))
+    t.eq(cx.execute("one.get() + two.get();"), 3)
+
+@t.cx()
+def test_mapping_keeps_item_lookup(cx):
+    cx.add_global("d", {"keys": "item"})
+    t.eq(cx.execute("d.keys;"), "item")
+
+class Point(object):
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+        self.label = "p"
+    def norm2(self):
+        return self.x * self.x + self.y * self.y
+
+@t.rt()
+def test_registered_class(rt):
+    rt.register_class(Point, properties={"x": "int", "y": int, "label": "str"},
+                        methods=["norm2"], readonly=["label"])
+    cx = rt.new_context()
+    p = Point(3, 4)
+    cx.add_global("p", p)
+    t.eq(cx.execute("p.x + p.y;"), 7)
+    t.eq(cx.execute("p.norm2();"), 25)
+    t.eq(cx.execute("p.hasOwnProperty('x');"), False)
+    cx.execute("p.x = 5;")
+    t.eq(p.x, 5)
+    t.raises(t.JSError, cx.execute, "p.y = 1.5;")
+    t.raises(t.JSError, cx.execute, "p.label = 'q';")
+    t.eq(p.label, "p")
+
+class Gauge(object):
+    def __init__(self):
+        self.level = 0.5
+        self.on = True
+
+@t.rt()
+def test_registered_conversions(rt):
+    t.raises(ValueError, rt.register_class, Gauge, {"level": "float"},
+                readonly=["missing"])
+    rt.register_class(Gauge, {"level": "float", "on": "bool", "n": "int"})
+    cx = rt.new_context()
+    g = Gauge()
+    cx.add_global("g", g)
+    t.eq(cx.execute("g.level + 1;"), 1.5)
+    t.raises(t.JSError, cx.execute, "g.level = 'abc';")
+    t.raises(t.JSError, cx.execute, "g.on = 1;")
+    cx.execute("g.level = 2; g.on = false;")
+    t.eq((g.level, g.on), (2.0, False))
+    g.on = "yes"
+    t.raises(t.JSError, cx.execute, "g.on;")
+    g.level = 10 ** 400
+    t.raises(t.JSError, cx.execute, "g.level;")
+    t.raises(t.JSError, cx.execute, "g.n = NaN;")
+    t.raises(t.JSError, cx.execute, "g.n = 1e300;")
+
+@t.rt()
+def test_registered_prototype_swap(rt):
+    class Small(object):
+        a = 1
+    class Big(object):
+        a, b, c = 1, 2, 3
+    rt.register_class(Small, ["a"])
+    rt.register_class(Big, ["a", "b", "c"])
+    cx = rt.new_context()
+    cx.add_global("s", Small())
+    cx.add_global("g", Big())
+    cx.execute("s.__proto__ = Object.getPrototypeOf(g);")
+    t.eq(cx.execute("s.b === undefined && s.c === undefined;"), True)
+    cx.execute("s.c = 5;")
+
+@t.rt()
+def test_register_class_twice(rt):
+    rt.register_class(Point, ["x"])
+    t.raises(ValueError, rt.register_class, Point, ["y"])
+
+class Record(object):
+    __slots__ = ("id", "score", "tag")
+    def __init__(self, id, score):
+        self.id = id
+        self.score = score
+
+@t.cx()
+def test_slot_members(cx):
+    r = Record(7, 1.5)
+    cx.add_global("r", r)
+    t.eq(cx.execute("r.id + r.score;"), 8.5)
+    t.eq(cx.execute("r.hasOwnProperty('id');"), False)
+    t.eq(cx.execute("r.tag;"), None)
+    cx.execute("r.tag = 'hot'; r.score = 2;")
+    t.eq(r.tag, "hot")
+    t.eq(r.score, 2)
+
+@t.cx()
+def test_slot_member_rebound(cx):
+    class Slotted(object):
+        __slots__ = ("score",)
+    s = Slotted()
+    s.score = 3
+    cx.add_global("s", s)
+    t.eq(cx.execute("s.score;"), 3)
+    Slotted.score = property(lambda self: 4)
+    t.eq(cx.execute("s.score;"), 4)
+
+@t.cx()
+def test_list_indexing(cx):
+    data = [1, 2, 3]
+    cx.add_global("data", data)
+    t.eq(cx.execute("var s = 0; for(var i = 0; i < data.length; i++) s += data[i]; s;"), 6)
+    cx.execute("data[1] = 'two';")
+    t.eq(data, [1, "two", 3])
+    t.eq(cx.execute("data[7];"), None)
+    cx.add_global("pair", ("a", "b"))
+    t.eq(cx.execute("pair.length + pair[1];"), "2b")
+
+@t.cx()
+def test_dict_fast_path(cx):
+    d = {"n": 4, 2: "two"}
+    cx.add_global("d", d)
+    t.eq(cx.execute("d.n + d[2];"), "4two")
+    t.eq(cx.execute("d.missing;"), None)
+    t.eq(cx.execute("d.keys().length;"), 2)
+    cx.execute("d.m = 5;")
+    t.eq(d[u"m"], 5)
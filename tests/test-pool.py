@@ -0,0 +1,70 @@
+# Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+#
+# This file is part of the python-spidermonkey package released
+# under the MIT license.
+import t
+import threading
+
+def test_create_pool():
+    pool = t.spidermonkey.Pool(2)
+    t.eq(pool.workers, 2)
+    pool.join()
+
+def test_submit_script():
+    pool = t.spidermonkey.Pool(2)
+    futures = [pool.submit("var x = %d; x * x;" % i) for i in range(10)]
+    t.eq([f.result() for f in futures], [i * i for i in range(10)])
+    pool.join()
+
+def test_submit_with_args():
+    pool = t.spidermonkey.Pool(2, contexts=2)
+    func = "(function(a, b) {return a + b;})"
+    futures = [pool.submit(func, (i, 1)) for i in range(10)]
+    t.eq([f.result() for f in futures], [i + 1 for i in range(10)])
+    pool.join()
+
+def test_results_are_detached():
+    pool = t.spidermonkey.Pool(1)
+    ret = pool.submit('({"a": [1, 2, {"b": "c"}]})').result()
+    t.eq(ret, {"a": [1, 2, {"b": "c"}]})
+    t.eq(type(ret), dict)
+    pool.join()
+
+def test_function_result_raises():
+    pool = t.spidermonkey.Pool(1)
+    future = pool.submit("(function() {});")
+    t.raises(TypeError, future.result)
+    pool.join()
+
+def test_script_error():
+    pool = t.spidermonkey.Pool(1)
+    future = pool.submit("throw 'oops';")
+    t.raises(t.JSError, future.result)
+    t.eq(isinstance(future.exception(), t.JSError), True)
+    pool.join()
+
+def test_submit_after_close():
+    pool = t.spidermonkey.Pool(1)
+    pool.close()
+    t.raises(RuntimeError, pool.submit, "1;")
+    pool.join()
+
+def test_shared_global():
+    glbl = {"base": 10}
+    pool = t.spidermonkey.Pool(2, glbl=glbl)
+    t.eq(pool.submit("base + 1;").result(), 11)
+    pool.join()
+
+def test_context_wrong_thread():
+    rt = t.spidermonkey.Runtime()
+    cx = rt.new_context()
+    errors = []
+    def run():
+        try:
+            cx.execute("1;")
+        except t.JSError:
+            errors.append(True)
+    thread = threading.Thread(target=run)
+    thread.start()
+    thread.join()
+    t.eq(errors, [True])
@@ -19,3 +19,48 @@ def test_exceed_memory():
     script = "var b = []; for (var i = 0; i < 1000000; i++) b.push('string: ' + i);"
     t.raises(t.JSError, cx.execute, script)
 
+def test_no_helper_threads_by_default():
+    status = t.spidermonkey.Runtime().helper_status()
+    t.eq(status["helper_threads_requested"], 0)
+    t.eq(status["off_thread_compilation_allowed"], False)
+    t.eq(status["background_sweeping_allowed"], False)
+
+def test_helper_threads():
+    rt = t.spidermonkey.Runtime(helper_threads=2, incremental_gc=True)
+    status = rt.helper_status()
+    t.eq(status["helper_threads_requested"], 2)
+    t.eq(status["off_thread_compilation_allowed"], True)
+    t.eq(status["background_sweeping_allowed"], True)
+    t.eq(status["gc_mode"], "incremental")
+    cx = rt.new_context()
+    t.eq(cx.execute("var x = 0; for(var i = 0; i < 100000; i++) x += i; x;"),
+            4999950000)
+
+def test_invalid_helper_threads():
+    t.raises(ValueError, t.spidermonkey.Runtime, helper_threads=-1)
+
+@t.rt()
+def test_script_cache(rt):
+    t.eq(rt.script_cache(2), 0)
+    cx = rt.new_context({'a': 5})
+    t.eq(cx.execute("a + 1;"), 6)
+    t.eq(cx.execute("a + 1;"), 6)
+    t.eq(cx.execute(u"a + 2;"), 7)
+    t.eq(cx.execute("a + 3;"), 8)
+    stats = rt.script_cache_stats()
+    t.eq(stats["entries"], 2)
+    t.eq(stats["hits"], 1)
+    t.eq(stats["misses"], 3)
+    t.eq(stats["evictions"], 1)
+    t.eq(rt.script_cache(0), 2)
+    t.eq(rt.script_cache_stats()["entries"], 0)
+    t.eq(cx.execute("a + 1;"), 6)
+
+@t.rt()
+def test_script_cache_errors(rt):
+    rt.script_cache(4)
+    cx = rt.new_context()
+    t.raises(Exception, cx.execute, "throw 1;")
+    t.raises(Exception, cx.execute, "throw 1;")
+    t.eq(rt.script_cache_stats()["hits"], 1)
+    t.raises(ValueError, rt.script_cache, -1)
@@ -0,0 +1,40 @@
+# Copyright 2009 Paul J. Davis <paul.joseph.davis@gmail.com>
+#
+# This file is part of the python-spidermonkey package released
+# under the MIT license.
+import t
+import threading
+
+SPIN = """
+    var start = (new Date()).getTime();
+    while(((new Date()).getTime() - start) < 300) {}
+    true;
+"""
+
+def test_gil_released_during_execute():
+    result = []
+    def run():
+        rt = t.spidermonkey.Runtime()
+        cx = rt.new_context()
+        result.append(cx.execute(SPIN))
+    thread = threading.Thread(target=run)
+    thread.start()
+    ticks = 0
+    while thread.is_alive():
+        ticks += 1
+    thread.join()
+    t.eq(result, [True])
+    t.gt(ticks, 1000)
+
+def test_callbacks_from_threads():
+    results = {}
+    def run(n):
+        rt = t.spidermonkey.Runtime()
+        cx = rt.new_context({"n": n, "double": lambda x: x * 2})
+        results[n] = cx.execute("var r = 0; for(var i = 0; i < 100; i++) r += double(n); r;")
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    t.eq(results, dict((i, i * 200) for i in range(4)))
@@ -15,3 +15,33 @@ def test_unicode_string(cx):
 @t.cx()
 def test_non_unicode_string(cx):
     t.eq(cx.execute("5"), 5)
+
+@t.cx()
+def test_ascii_str_length(cx):
+    cx.add_global("s", "hello")
+    t.eq(cx.execute("s.length;"), 5)
+
+@t.cx()
+def test_utf8_str(cx):
+    cx.add_global("s", "caf\xc3\xa9")
+    t.eq(cx.execute("s.length;"), 4)
+    t.eq(cx.execute("s.charCodeAt(3);"), 0xE9)
+
+@t.cx()
+def test_bmp_unicode(cx):
+    cx.add_global("s", u"\u4e2d\u6587")
+    t.eq(cx.execute("s.length;"), 2)
+    t.eq(cx.execute("s.charCodeAt(1);"), 0x6587)
+
+@t.cx()
+def test_astral_unicode(cx):
+    cx.add_global("s", u"a\U0001F600b")
+    t.eq(cx.execute("s.length;"), 4)
+    t.eq(cx.execute("s.charCodeAt(1);"), 0xD83D)
+    t.eq(cx.execute("s.charCodeAt(2);"), 0xDE00)
+
+@t.cx()
+def test_js_to_python(cx):
+    t.eq(cx.execute('"abc";'), u"abc")
+    t.eq(cx.execute('"\\u00e9\\u4e2d";'), u"\xe9\u4e2d")
+    t.eq(cx.execute('"\\ud83d\\ude00";'), u"\U0001F600")